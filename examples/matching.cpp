@@ -22,6 +22,7 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <aam/aam.h>
 #include <aam/matcher.h>
+#include <aam/multistart.h>
 
 #include <opencv2/highgui/highgui.hpp>
 #include <iostream>
@@ -80,12 +81,20 @@ int main(int argc, char **argv)
 
     std::cout << "init matcher..." << std::endl;
 
-    // initialize the AAM matcher
-    srand((unsigned int)time(0));
-    aam::Scalar x = 320;
-    aam::Scalar y = 240;
-    aam::Scalar scaling = 1.0;
-    matcher.init(image, x, y, scaling, shapeParams, appearanceParams);
+    // search for the initial pose by fitting from a grid of starting poses in parallel
+    aam::MultiStartMatcher search(model);
+    search.setPositionGrid(cv::Rect(0, 0, image.cols, image.rows), 6, 4);
+    std::vector<aam::Scalar> scalings;
+    scalings.push_back(aam::Scalar(0.8));
+    scalings.push_back(aam::Scalar(1.0));
+    scalings.push_back(aam::Scalar(1.25));
+    search.setScalings(scalings);
+    aam::Scalar error = search.fit(image, pose, shapeParams, appearanceParams);
+    std::cout << "best starting pose found with error " << error << std::endl;
+
+    // initialize the AAM matcher at the pose found
+    matcher.init(image, 0, 0, 1, shapeParams, appearanceParams);
+    matcher.setCurrentGlobalTransform(pose);
 
     std::cout << "press 'a' to match without further keypress" << std::endl;
     std::cout << "press other key to match step by step" << std::endl;
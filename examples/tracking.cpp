@@ -0,0 +1,102 @@
+/**
+This file is part of Active Appearance Models (AAM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AAM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AAM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AAM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <aam/aam.h>
+#include <aam/tracker.h>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <iostream>
+
+/**
+ 
+ Main entry point.
+ 
+ */
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " directory [video]" << std::endl;
+        return 0;
+    }
+
+    aam::TrainingSet trainingSet;
+    aam::loadAsfTrainingSet(argv[1], trainingSet);
+    aam::Trainer::createTriangulation(trainingSet);
+
+    aam::ActiveAppearanceModel model;
+    aam::Trainer trainer(trainingSet);
+    trainer.train(model);
+    model.setNumShapeModes(3);
+    model.setNumAppearanceModes(15);
+
+    cv::VideoCapture capture;
+    if (argc > 2) {
+        capture = cv::VideoCapture(argv[2]);
+    } else {
+        capture = cv::VideoCapture(0);
+    }
+
+    if (!capture.isOpened()) {
+        std::cout << "Failed to open video source" << std::endl;
+        return 0;
+    }
+
+    std::cout << "press 'r' to restart tracking at the image center" << std::endl;
+    std::cout << "press Escape to quit" << std::endl;
+
+    aam::Tracker tracker(model);
+    tracker.setStepsPerFrame(5);
+    tracker.setPosePrediction(true);
+
+    aam::Affine2 pose;
+    aam::RowVectorX shapeParams;
+    aam::RowVectorX appearanceParams;
+
+    cv::Mat frame, gray;
+    bool first = true;
+    int key = 0;
+    while (key != 27 && capture.read(frame)) {
+
+        if (frame.channels() == 3) {
+            cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+        } else {
+            gray = frame;
+        }
+
+        if (first || key == 'r') {
+            tracker.reset((aam::Scalar)gray.cols / 2, (aam::Scalar)gray.rows / 2, 1);
+            first = false;
+        }
+
+        aam::Scalar error = tracker.fit(gray, pose, shapeParams, appearanceParams);
+
+        cv::Mat imgShowShape = gray.clone();
+        model.renderShapeInstanceToImage(imgShowShape, pose, shapeParams);
+        cv::imshow("TrackedShape", imgShowShape);
+
+        std::cout << "error: " << error << std::endl;
+
+        key = cv::waitKey(1);
+    }
+
+	return 0;
+}
\ No newline at end of file
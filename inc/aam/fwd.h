@@ -28,6 +28,7 @@ namespace aam {
     class TrainingSet;
     class ParametrizedTriangle;
     class ActiveAppearanceModel;
+    class AsfTrainingSetLoader;
 }
 
 #endif
\ No newline at end of file
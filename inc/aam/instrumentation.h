@@ -0,0 +1,138 @@
+/**
+This file is part of Active Appearance Models (AAM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AAM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AAM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AAM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAM_INSTRUMENTATION_H
+#define AAM_INSTRUMENTATION_H
+
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+/** Instrumentation of training, fitting and loading stages.
+
+    Stages are timed by AAM_SCOPED_TIMER and items processed are counted by AAM_COUNT. Both expand 
+    to nothing unless AAM_INSTRUMENTATION is defined, so instrumented code carries no cost by default.
+    Statistics are accumulated process wide and are safe to update from multiple threads. Stages 
+    may nest, e.g. FIT_STEP includes the other fitting stages.
+ */
+#ifdef AAM_INSTRUMENTATION
+#define AAM_INSTRUMENTATION_CONCAT_(a, b) a##b
+#define AAM_INSTRUMENTATION_CONCAT(a, b) AAM_INSTRUMENTATION_CONCAT_(a, b)
+#define AAM_SCOPED_TIMER(stage) aam::instrumentation::ScopedTimer AAM_INSTRUMENTATION_CONCAT(aamScopedTimer, __LINE__)(aam::instrumentation::stage)
+#define AAM_COUNT(stage, n) aam::instrumentation::count(aam::instrumentation::stage, (uint64_t)(n))
+#else
+#define AAM_SCOPED_TIMER(stage)
+#define AAM_COUNT(stage, n)
+#endif
+
+namespace aam {
+    namespace instrumentation {
+
+        /** Instrumented stages */
+        enum Stage {
+            /** generalized Procrustes analysis of training shapes */
+            TRAIN_PROCRUSTES,
+            /** rasterization of the mean shape, items are samples */
+            TRAIN_RASTERIZE,
+            /** sampling of training images, items are samples */
+            TRAIN_SAMPLING,
+            /** shape and appearance PCA */
+            TRAIN_PCA,
+            /** one step of Matcher2, items are steps */
+            FIT_STEP,
+            /** one damped update tried within a step, items are trials */
+            FIT_TRIAL,
+            /** shape instance generation */
+            FIT_COORDINATES,
+            /** image sampling, items are samples */
+            FIT_SAMPLING,
+            /** error image and error evaluation */
+            FIT_RESIDUAL,
+            /** linearization, solve and parameter update */
+            FIT_UPDATE,
+            /** parsing of landmark files, items are examples */
+            LOAD_PARSE,
+            /** decoding of training images, items are images */
+            LOAD_DECODE,
+
+            NUM_STAGES
+        };
+
+        /** Accumulated statistics of a stage */
+        struct StageStatistics {
+            /** stage name as used in JSON output */
+            const char *name;
+            /** number of times the stage was timed */
+            uint64_t calls;
+            /** number of items processed, see Stage */
+            uint64_t items;
+            /** total time spent in seconds */
+            double totalSeconds;
+            /** longest single call in seconds */
+            double maxSeconds;
+        };
+
+        /** Snapshot of all stages */
+        struct Report {
+            /** true when compiled with AAM_INSTRUMENTATION */
+            bool enabled;
+            StageStatistics stages[NUM_STAGES];
+
+            /** Statistics of a stage */
+            const StageStatistics& operator[](Stage stage) const { return stages[stage]; }
+
+            /** Report as JSON object, keyed by stage name. Times are given in milliseconds. */
+            std::string toJson() const;
+        };
+
+        /** Take a snapshot of the statistics accumulated since startup or the last reset */
+        Report report();
+
+        /** Clear accumulated statistics */
+        void reset();
+
+        /** Add a timed call to a stage */
+        void record(Stage stage, std::chrono::steady_clock::duration elapsed);
+
+        /** Add processed items to a stage */
+        void count(Stage stage, uint64_t items);
+
+        /** Records the lifetime of the timer to a stage, see AAM_SCOPED_TIMER */
+        class ScopedTimer {
+        public:
+            explicit ScopedTimer(Stage stage) 
+                :_stage(stage), _start(std::chrono::steady_clock::now())
+            {}
+
+            ~ScopedTimer() {
+                record(_stage, std::chrono::steady_clock::now() - _start);
+            }
+
+        private:
+            ScopedTimer(const ScopedTimer&);
+            ScopedTimer& operator=(const ScopedTimer&);
+
+            Stage _stage;
+            std::chrono::steady_clock::time_point _start;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -22,10 +22,104 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #define AAM_IO_H
 
 #include <aam/fwd.h>
+#include <aam/types.h>
+#include <opencv2/core/core.hpp>
+#include <string>
+#include <memory>
+#include <vector>
 
 namespace aam {
 
-    bool loadAsfTrainingSet(const std::string& directory, TrainingSet& trainingSet, int firstNExamplesToLoad = -1);
+    /** Result of parsing landmarks in ASF format */
+    enum AsfParseResult {
+        /** landmarks parsed */
+        ASF_OK,
+        /** file could not be read */
+        ASF_FILE_ERROR,
+        /** number of points missing or invalid */
+        ASF_INVALID_POINT_COUNT,
+        /** point line with missing or invalid fields */
+        ASF_INVALID_POINT,
+        /** fewer point lines than announced */
+        ASF_MISSING_POINTS
+    };
+
+    /** Parse landmarks in ASF format from the given character range, which need not be null terminated. 
+        Coordinates are relative to the image size and stored interleaved in coords, point ids and 
+        connections are stored in contour (one row per point). Both are only reallocated when the 
+        number of points changes. */
+    AsfParseResult parseAsf(const char *begin, const char *end, RowVectorX &coords, cv::Mat &contour);
+
+    /** Parse an ASF file, see parseAsf. The file is read into buffer, which can be reused across calls. */
+    AsfParseResult parseAsfFile(const std::string& fileName, RowVectorX &coords, cv::Mat &contour, std::vector<char> &buffer);
+
+    /** Loader of training sets in ASF format.
+
+        The directory is enumerated once and all landmark files are parsed up front. Images are 
+        decoded by a pool of worker threads into a bounded queue and handed out in the order of 
+        the examples, so consumers such as Trainer::train can process one image while the next 
+        ones are being decoded. Examples are named <major>-<minor><m|f>.asf/.jpg and ordered by 
+        major and minor index.
+     */
+    class AsfTrainingSetLoader {
+    public:
+
+        /** Constructor. Images are loaded as gray images unless color is set. A thread count of zero 
+            uses one thread per core, queueCapacity limits the number of decoded images held. */
+        AsfTrainingSetLoader(const std::string& directory, int firstNExamplesToLoad = -1, bool color = false, int nThreads = 0, int queueCapacity = 8);
+
+        /** Destructor, stops decoding */
+        ~AsfTrainingSetLoader();
+
+        /** Crop images to the bounding box of their shape enlarged by margin pixels and offset shapes 
+            accordingly. Cropped images are copies, so full images are not kept in memory. A negative 
+            margin (the default) keeps full images. Call before open. */
+        void setCropMargin(int margin);
+
+        /** Downscale images such that the larger side of their shape spans at most the given number 
+            of pixels and scale shapes accordingly, e.g. to the appearance resolution of the trainer 
+            (see Trainer::setAppearanceResolution). Zero (the default) keeps the resolution. Call before open. */
+        void setTargetResolution(Scalar pixels);
+
+        /** Parse the landmarks of all examples into the shapes and contour of the training set and 
+            start decoding images. Images are not added to the training set, see next. */
+        bool open(TrainingSet& trainingSet);
+
+        /** Number of examples found */
+        int size() const;
+
+        /** Wait for the image of the next example. Returns false once all images have been handed out
+            or if the image of the next example could not be read or decoded (see failed). No further 
+            images are handed out after a failure. */
+        bool next(cv::Mat& image);
+
+        /** True if next stopped because an image could not be read or decoded */
+        bool failed() const;
+
+        /** Index of the example whose image could not be read or decoded, -1 if none */
+        int failedExample() const;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> _impl;
+    };
+
+    /** Load a training set in ASF format. Images are loaded as gray images unless color is set,
+        in which case color models are trained (see ActiveAppearanceModel::appearanceChannels). 
+        Images are decoded in parallel, see AsfTrainingSetLoader. Returns false if a landmark file 
+        could not be parsed or an image could not be read or decoded. */
+    bool loadAsfTrainingSet(const std::string& directory, TrainingSet& trainingSet, int firstNExamplesToLoad = -1, bool color = false);
+
+    /** Save a training set to a binary cache file. Images are stored decoded, so that repeated 
+        training runs need neither parse landmark files nor decode images. */
+    bool saveTrainingSetCache(const std::string& path, const TrainingSet& trainingSet);
+
+    /** Load a training set from a binary cache file written by saveTrainingSetCache. The file is 
+        memory mapped and images refer to the mapped pages without copying; TrainingSet::storage 
+        keeps the mapping alive. Modifying images does not alter the file. Returns false, leaving 
+        trainingSet unchanged, if the file is not a training set cache or its contents are inconsistent, 
+        e.g. if the number of shapes and images differ. */
+    bool loadTrainingSetCache(const std::string& path, TrainingSet& trainingSet);
 }
 
 #endif
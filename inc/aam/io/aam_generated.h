@@ -101,6 +101,7 @@ struct ActiveAppearanceModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Tabl
   const MatrixX *appearanceMean() const { return GetPointer<const MatrixX *>(16); }
   const MatrixX *appearanceModes() const { return GetPointer<const MatrixX *>(18); }
   const MatrixX *appearanceModeWeights() const { return GetPointer<const MatrixX *>(20); }
+  const MatrixX *appearanceMeanGradient() const { return GetPointer<const MatrixX *>(22); }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<flatbuffers::uoffset_t>(verifier, 4 /* shapeMean */) &&
@@ -121,6 +122,8 @@ struct ActiveAppearanceModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Tabl
            verifier.VerifyTable(appearanceModes()) &&
            VerifyField<flatbuffers::uoffset_t>(verifier, 20 /* appearanceModeWeights */) &&
            verifier.VerifyTable(appearanceModeWeights()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, 22 /* appearanceMeanGradient */) &&
+           verifier.VerifyTable(appearanceMeanGradient()) &&
            verifier.EndTable();
   }
 };
@@ -137,10 +140,11 @@ struct ActiveAppearanceModelBuilder {
   void add_appearanceMean(flatbuffers::Offset<MatrixX> appearanceMean) { fbb_.AddOffset(16, appearanceMean); }
   void add_appearanceModes(flatbuffers::Offset<MatrixX> appearanceModes) { fbb_.AddOffset(18, appearanceModes); }
   void add_appearanceModeWeights(flatbuffers::Offset<MatrixX> appearanceModeWeights) { fbb_.AddOffset(20, appearanceModeWeights); }
+  void add_appearanceMeanGradient(flatbuffers::Offset<MatrixX> appearanceMeanGradient) { fbb_.AddOffset(22, appearanceMeanGradient); }
   ActiveAppearanceModelBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
   ActiveAppearanceModelBuilder &operator=(const ActiveAppearanceModelBuilder &);
   flatbuffers::Offset<ActiveAppearanceModel> Finish() {
-    auto o = flatbuffers::Offset<ActiveAppearanceModel>(fbb_.EndTable(start_, 9));
+    auto o = flatbuffers::Offset<ActiveAppearanceModel>(fbb_.EndTable(start_, 10));
     return o;
   }
 };
@@ -154,8 +158,10 @@ inline flatbuffers::Offset<ActiveAppearanceModel> CreateActiveAppearanceModel(fl
    flatbuffers::Offset<MatrixX> barycentricSamplePositions = 0,
    flatbuffers::Offset<MatrixX> appearanceMean = 0,
    flatbuffers::Offset<MatrixX> appearanceModes = 0,
-   flatbuffers::Offset<MatrixX> appearanceModeWeights = 0) {
+   flatbuffers::Offset<MatrixX> appearanceModeWeights = 0,
+   flatbuffers::Offset<MatrixX> appearanceMeanGradient = 0) {
   ActiveAppearanceModelBuilder builder_(_fbb);
+  builder_.add_appearanceMeanGradient(appearanceMeanGradient);
   builder_.add_appearanceModeWeights(appearanceModeWeights);
   builder_.add_appearanceModes(appearanceModes);
   builder_.add_appearanceMean(appearanceMean);
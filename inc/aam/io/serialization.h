@@ -24,6 +24,8 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #include <aam/fwd.h>
 #include <aam/types.h>
 #include <aam/io/aam_generated.h>
+#include <aam/io/trainingset_generated.h>
+#include <opencv2/core/core.hpp>
 
 namespace aam {
     namespace io {
@@ -40,6 +42,12 @@ namespace aam {
         /** Serialize ActiveAppearanceModel to flatbuffers storage */
         flatbuffers::Offset<::aam::io::ActiveAppearanceModel> toFlatbuffers(flatbuffers::FlatBufferBuilder &fbb, const ::aam::ActiveAppearanceModel &m);
 
+        /** Serialize image to flatbuffers storage */
+        flatbuffers::Offset<::aam::io::Image> toFlatbuffers(flatbuffers::FlatBufferBuilder &fbb, const cv::Mat &m);
+
+        /** Serialize TrainingSet to flatbuffers storage */
+        flatbuffers::Offset<::aam::io::TrainingSet> toFlatbuffers(flatbuffers::FlatBufferBuilder &fbb, const ::aam::TrainingSet &t);
+
         /** Serialize matrix from flatbuffers storage */
         void fromFlatbuffers(const ::aam::io::MatrixX &mfb, aam::MatrixX &m);
         
@@ -54,6 +62,14 @@ namespace aam {
 
         /** Serialize ActiveAppearanceModel from flatbuffers storage */
         void fromFlatbuffers(const ::aam::io::ActiveAppearanceModel &mfb, ::aam::ActiveAppearanceModel &m);
+
+        /** Serialize image from flatbuffers storage. Creates a header referring to the storage, no pixels are copied. 
+            Returns false if the type is invalid or the size of the pixel data does not match. */
+        bool fromFlatbuffers(const ::aam::io::Image &mfb, cv::Mat &m);
+
+        /** Serialize TrainingSet from flatbuffers storage. Images refer to the storage, no pixels are copied. 
+            Returns false if a field is missing or its size does not match, t is partially filled then. */
+        bool fromFlatbuffers(const ::aam::io::TrainingSet &tfb, ::aam::TrainingSet &t);
     }    
 }
 
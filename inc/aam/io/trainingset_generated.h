@@ -0,0 +1,121 @@
+// automatically generated by the FlatBuffers compiler, do not modify
+
+#ifndef FLATBUFFERS_GENERATED_TRAININGSET_AAM_IO_H_
+#define FLATBUFFERS_GENERATED_TRAININGSET_AAM_IO_H_
+
+#include "flatbuffers/flatbuffers.h"
+
+#include "aam_generated.h"
+
+namespace aam {
+namespace io {
+
+struct Image;
+struct TrainingSet;
+
+struct Image FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  int32_t rows() const { return GetField<int32_t>(4, 0); }
+  int32_t cols() const { return GetField<int32_t>(6, 0); }
+  int32_t type() const { return GetField<int32_t>(8, 0); }
+  const flatbuffers::Vector<uint8_t> *data() const { return GetPointer<const flatbuffers::Vector<uint8_t> *>(10); }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<int32_t>(verifier, 4 /* rows */) &&
+           VerifyField<int32_t>(verifier, 6 /* cols */) &&
+           VerifyField<int32_t>(verifier, 8 /* type */) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, 10 /* data */) &&
+           verifier.Verify(data()) &&
+           verifier.EndTable();
+  }
+};
+
+struct ImageBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_rows(int32_t rows) { fbb_.AddElement<int32_t>(4, rows, 0); }
+  void add_cols(int32_t cols) { fbb_.AddElement<int32_t>(6, cols, 0); }
+  void add_type(int32_t type) { fbb_.AddElement<int32_t>(8, type, 0); }
+  void add_data(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> data) { fbb_.AddOffset(10, data); }
+  ImageBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
+  ImageBuilder &operator=(const ImageBuilder &);
+  flatbuffers::Offset<Image> Finish() {
+    auto o = flatbuffers::Offset<Image>(fbb_.EndTable(start_, 4));
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<Image> CreateImage(flatbuffers::FlatBufferBuilder &_fbb,
+   int32_t rows = 0,
+   int32_t cols = 0,
+   int32_t type = 0,
+   flatbuffers::Offset<flatbuffers::Vector<uint8_t>> data = 0) {
+  ImageBuilder builder_(_fbb);
+  builder_.add_data(data);
+  builder_.add_type(type);
+  builder_.add_cols(cols);
+  builder_.add_rows(rows);
+  return builder_.Finish();
+}
+
+struct TrainingSet FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  const MatrixX *shapes() const { return GetPointer<const MatrixX *>(4); }
+  const MatrixXi *triangles() const { return GetPointer<const MatrixXi *>(6); }
+  const Image *contour() const { return GetPointer<const Image *>(8); }
+  const flatbuffers::Vector<flatbuffers::Offset<Image>> *images() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<Image>> *>(10); }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, 4 /* shapes */) &&
+           verifier.VerifyTable(shapes()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, 6 /* triangles */) &&
+           verifier.VerifyTable(triangles()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, 8 /* contour */) &&
+           verifier.VerifyTable(contour()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, 10 /* images */) &&
+           verifier.Verify(images()) &&
+           verifier.VerifyVectorOfTables(images()) &&
+           verifier.EndTable();
+  }
+};
+
+struct TrainingSetBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_shapes(flatbuffers::Offset<MatrixX> shapes) { fbb_.AddOffset(4, shapes); }
+  void add_triangles(flatbuffers::Offset<MatrixXi> triangles) { fbb_.AddOffset(6, triangles); }
+  void add_contour(flatbuffers::Offset<Image> contour) { fbb_.AddOffset(8, contour); }
+  void add_images(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Image>>> images) { fbb_.AddOffset(10, images); }
+  TrainingSetBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
+  TrainingSetBuilder &operator=(const TrainingSetBuilder &);
+  flatbuffers::Offset<TrainingSet> Finish() {
+    auto o = flatbuffers::Offset<TrainingSet>(fbb_.EndTable(start_, 4));
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<TrainingSet> CreateTrainingSet(flatbuffers::FlatBufferBuilder &_fbb,
+   flatbuffers::Offset<MatrixX> shapes = 0,
+   flatbuffers::Offset<MatrixXi> triangles = 0,
+   flatbuffers::Offset<Image> contour = 0,
+   flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Image>>> images = 0) {
+  TrainingSetBuilder builder_(_fbb);
+  builder_.add_images(images);
+  builder_.add_contour(contour);
+  builder_.add_triangles(triangles);
+  builder_.add_shapes(shapes);
+  return builder_.Finish();
+}
+
+inline const aam::io::TrainingSet *GetTrainingSet(const void *buf) { return flatbuffers::GetRoot<aam::io::TrainingSet>(buf); }
+
+inline bool VerifyTrainingSetBuffer(flatbuffers::Verifier &verifier) { return verifier.VerifyBuffer<aam::io::TrainingSet>(); }
+
+inline const char *TrainingSetIdentifier() { return "AAMT"; }
+
+inline bool TrainingSetBufferHasIdentifier(const void *buf) { return flatbuffers::BufferHasIdentifier(buf, TrainingSetIdentifier()); }
+
+inline void FinishTrainingSetBuffer(flatbuffers::FlatBufferBuilder &fbb, flatbuffers::Offset<aam::io::TrainingSet> root) { fbb.Finish(root, TrainingSetIdentifier()); }
+
+}  // namespace io
+}  // namespace aam
+
+#endif  // FLATBUFFERS_GENERATED_TRAININGSET_AAM_IO_H_
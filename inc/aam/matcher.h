@@ -24,10 +24,13 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #include <aam/fwd.h>
 #include <aam/types.h>
 #include <aam/model.h>
+#include <Eigen/Cholesky>
+#include <random>
+#include <memory>
 
 namespace aam {
    
-    /** class for matching an AAM using the inverse compositional approach */
+    /** class for matching an AAM using the inverse compositional approach. Supports gray models only. */
     class Matcher {
 
     private:
@@ -35,7 +38,7 @@ namespace aam {
         /** The model that is matched to images */
         ActiveAppearanceModel model;
 
-        /** the input image to which the model is matched */
+        /** the input image to which the model is matched, bound by reference */
         cv::Mat image;
 
         /** pre-computed gradient images, matrices are 1x2 */
@@ -47,8 +50,8 @@ namespace aam {
         /** pre-computed steepest descent images, matrices are 1x4 */
         std::vector<MatrixX> steepestDecentImgs;
 
-        /** pre-computed inverse hessian, matrix is 4x4 */
-        MatrixX invHessian;
+        /** pre-computed hessian, matrix is 4x4 */
+        MatrixX hessian;
 
         /** pre-computed cartesian coordinates of sample positions (relative to mean shape) */
         std::vector<RowVector2> coords;
@@ -56,6 +59,12 @@ namespace aam {
         /** current warp */
         Affine2 currentWarp;
 
+        /** Levenberg-Marquardt damping, adapted per step */
+        Scalar damping;
+
+        /** sum of squared differences between image and mean appearance at the given warp */
+        Scalar evaluateError(const Affine2& warp);
+
     public:
 
         /** Constructor */
@@ -64,7 +73,8 @@ namespace aam {
         /** Initialize the matching (i.e. pre-compute various entities) */
         void init(const cv::Mat& img, aam::Scalar x, aam::Scalar y, aam::RowVectorX& shapeParams, aam::RowVectorX& textureParams);
 
-        /** match the active appearance model to the given image */
+        /** perform a single Levenberg-Marquardt step. The Gauss-Newton update is damped until it 
+            decreases the error, the damping is carried over to the next step. */
         void step();
 
         /** returns the current warp */
@@ -73,34 +83,123 @@ namespace aam {
 
 
 
-	/** class for matching an AAM using the inverse compositional approach */
+	/** class for matching an AAM using inverse compositional approaches.
+
+        The project-out algorithm projects appearance variation out of the fitting, its per-iteration 
+        cost is independent of the number of appearance modes. The simultaneous algorithm jointly 
+        updates shape and appearance parameters and is more accurate at a higher cost. Its Hessian is 
+        assembled per iteration from pre-computed products of per-mode steepest descent images.
+
+        Copies of a matcher share the model and all pre-computed entities, but carry their own image
+        and parameters. Copies of an initialized matcher may be fitted in parallel.
+
+        Images are expected to be of type CV_8UC1 for gray models and CV_8UC3 for color models (see 
+        ActiveAppearanceModel::appearanceChannels). Color channels are sampled at shared positions and 
+        contribute one residual each.
+     */
     class Matcher2 {
 
+    public:
+
+        /** fitting algorithm */
+        enum Algorithm {
+            /** project-out inverse compositional */
+            PROJECT_OUT,
+            /** simultaneous inverse compositional */
+            SIMULTANEOUS
+        };
+
+        /** error function */
+        enum RobustError {
+            /** sum of squared differences */
+            LEAST_SQUARES,
+            /** Huber M-estimator */
+            HUBER,
+            /** Tukey biweight M-estimator */
+            TUKEY,
+            /** Cauchy M-estimator */
+            CAUCHY
+        };
+
+        /** selection of sample subsets */
+        enum SampleSelection {
+            /** samples with the largest steepest descent magnitude, always a single subset */
+            GRADIENT_MAGNITUDE,
+            /** random samples, the same fraction drawn from each triangle */
+            STRATIFIED_RANDOM
+        };
+
     private:
 
-        /** The model that is matched to images */
-        ActiveAppearanceModel model;
+        /** The fitting algorithm used */
+        Algorithm algorithm;
+
+        /** error function used by the project-out algorithm */
+        RobustError robustError;
+
+        /** scale of residuals for robust error functions, zero to estimate per step */
+        Scalar robustScale;
 
-        /** the input image to which the model is matched */
+        /** The model that is matched to images, shared with copies of this matcher */
+        std::shared_ptr<const ActiveAppearanceModel> model;
+
+        /** the input image (or region of it) to which the model is matched, bound by reference */
         cv::Mat image;
 
-        /** pre-computed gradient images, matrices are 1x2 */
-        std::vector<MatrixX> grad;
+        /** position of the bound image region within the input image */
+        cv::Point imageOffset;
 
-        /** pre-computed jacobians of global shape transform, matrices are 2x4 */
-        std::vector<MatrixX> globalTrafoJacobians;
+        /** the full input image when only a region of it is bound, see setImageROI */
+        cv::Mat fullImage;
 
-        /** pre-computed jacobians warp, matrices are nbPixels x nbShapeParameters */
-        std::vector<MatrixX> warpJacobians;
+        /** margin around the shape instance of the bound region, negative if the full image is bound */
+        int roiMargin;
 
-        /** pre-computed steepest descent images, matrices are 1x4 */
-        std::vector<MatrixX> steepestDescentImgs;
+        /** pre-computed entities for fitting on a set of samples */
+        struct SampleSet {
+            /** indices of samples in this set */
+            std::vector<int> indices;
 
-        /** pre-computed inverse hessian, matrix is 4x4 */
-        MatrixX invHessian;
+            /** steepest descent images (rows) of the samples. Project-out: projected steepest descent 
+                images, nbSamples x nbParams. Simultaneous: steepest descent images of the mean appearance
+                and of each appearance mode side by side, nbSamples x (nbParams * (nbAppearanceParams + 1)) */
+            MatrixX steepestDescent;
 
-        /** pre-computed cartesian coordinates of sample positions (relative to mean shape) */
-        std::vector<RowVector2> coords;
+            /** project-out: Gauss-Newton Hessian of the steepest descent images, nbParams x nbParams */
+            TrainingMatrixX hessian;
+
+            /** project-out: least squares projection onto the appearance modes, nbAppearanceParams x nbSamples.
+                simultaneous: appearance modes, nbAppearanceParams x nbSamples */
+            MatrixX appearanceModes;
+
+            /** simultaneous: products of all pairs of steepest descent blocks */
+            TrainingMatrixX blockProducts;
+
+            /** simultaneous: products of steepest descent blocks and appearance modes */
+            TrainingMatrixX appearanceProducts;
+
+            /** products of appearance modes restricted to the samples of this set */
+            TrainingMatrixX appearanceGram;
+
+            /** project-out: triangle of each sample */
+            std::vector<int> sampleTriangles;
+
+            /** project-out: number of samples per triangle */
+            std::vector<int> triangleSampleCounts;
+
+            /** project-out: contributions of the samples of each triangle to the Hessian stacked, 
+                (nbTriangles * nbParams) x nbParams */
+            TrainingMatrixX triangleHessians;
+        };
+
+        /** pre-computed entities for fitting on all samples, shared with copies of this matcher */
+        std::shared_ptr<const SampleSet> allSamples;
+
+        /** pre-computed entities for fitting on subsets of samples, empty when fitting on all samples */
+        std::vector< std::shared_ptr<const SampleSet> > sampleSubsets;
+
+        /** random number generator used for subset selection */
+        std::mt19937 rng;
 
         /** current warp */
         Affine2 currentWarp;
@@ -111,25 +210,198 @@ namespace aam {
         /** current appearance params */
         RowVectorX currentAppearanceParams;
 
+        /** root mean squared error measured in the last step */
+        Scalar currentError;
+
+        /** Levenberg-Marquardt damping, adapted per step */
+        Scalar damping;
+
+        /** Buffers reused by every step, sized for all samples in init so that steps do not allocate. 
+            Steps on subsets of samples use the leading rows of per sample buffers. */
+        struct Workspace {
+            /** differences at the current and at trial parameters, error image (one row per sample and channel) */
+            MatrixX diffImage;
+            MatrixX trialDiffImage;
+            MatrixX errorImage;
+
+            /** robust fitting: residuals left after removing the appearance instance, weighted 
+                residuals, absolute residuals and weights per triangle */
+            MatrixX residual;
+            MatrixX weightedDiff;
+            std::vector<Scalar> absResiduals;
+            std::vector<TrainingScalar> triangleWeights;
+
+            /** robust fitting: weighted normal equations of the appearance parameters, decomposition and solution */
+            TrainingMatrixX appearanceSystem;
+            TrainingMatrixX appearanceRhs;
+            Eigen::LDLT<TrainingMatrixX> appearanceLdlt;
+            TrainingMatrixX appearanceSolution;
+
+            /** shape instance in image coordinates */
+            RowVectorX shape;
+
+            /** products of steepest descent images and appearance modes with a difference image */
+            MatrixX sdDiff;
+            MatrixX modesDiff;
+
+            /** Gauss-Newton system, damped system, its decomposition and solution */
+            TrainingMatrixX hessian;
+            TrainingMatrixX b;
+            TrainingMatrixX damped;
+            Eigen::LDLT<TrainingMatrixX> ldlt;
+            TrainingMatrixX solution;
+
+            /** parameter update and parameters of the trial update */
+            MatrixX deltaParam;
+            RowVectorX trialShapeParams;
+            RowVectorX trialAppearanceParams;
+        };
+
+        Workspace work;
+
+        /** size the workspace for fitting on all samples */
+        void allocateWorkspace();
+
+        /** re-derive the bound region of the full image if the given shape instance (in image 
+            coordinates) is not contained in it, see setImageROI */
+        void updateImageROI(const RowVectorX& shape);
+
+        /** pre-compute entities of the project-out algorithm, returns false if the appearance modes are 
+            linearly dependent on the samples of the model */
+        bool precomputeProjectOut();
+
+        /** pre-compute entities of the simultaneous algorithm, returns false as above */
+        bool precomputeSimultaneous();
+
+        /** pre-compute hessian related entities of a set of samples from its steepest descent images. 
+            Returns false if the appearance modes are linearly dependent on the samples of the set. */
+        bool prepareSampleSet(SampleSet& set);
+
+        /** sample the difference between image and mean appearance at the given parameters. This is 
+            the cheap path used to evaluate trial updates, no derivatives are involved. */
+        void sampleDifference(const SampleSet& set, const Affine2& warp, const RowVectorX& shapeParams, Eigen::Ref<MatrixX> diffImage);
+
+        /** residual of a difference image left after removing the appearance instance of the given parameters */
+        void appearanceResidual(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, const RowVectorX& appearanceParams, Eigen::Ref<MatrixX> residual) const;
+
+        /** error image with respect to the current appearance, returns its root mean squared error */
+        Scalar measureError(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, Eigen::Ref<MatrixX> errorImage) const;
+
+        /** error minimized by the fitting algorithm given a difference image and appearance parameters */
+        Scalar evaluateError(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, const RowVectorX& appearanceParams, Scalar scale);
+
+        /** Gauss-Newton system in the workspace and, for project-out, appearance parameters of the 
+            current fit. Returns the scale of residuals used for robust fitting. */
+        Scalar linearize(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, const Eigen::Ref<const MatrixX>& errorImage);
+
+        /** Gauss-Newton system of the project-out algorithm */
+        void linearizeProjectOut(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, TrainingMatrixX& hessian, TrainingMatrixX& b);
+
+        /** scale of residuals, robustly estimated from the median absolute residual unless given by setRobustError */
+        Scalar estimateScale(const Eigen::Ref<const MatrixX>& residual);
+
+        /** Robust estimate of the project-out appearance parameters by iteratively reweighted least squares, 
+            starting from the given parameters. Residuals are normalized by scale, or by a scale estimated 
+            per iteration if scale is zero. */
+        void estimateAppearanceRobust(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, Scalar scale, RowVectorX& appearanceParams);
+
+        /** Gauss-Newton system of the project-out algorithm with robust weighting of the residual left after 
+            projecting out the appearance variation, returns the scale used */
+        Scalar linearizeProjectOutRobust(const SampleSet& set, const Eigen::Ref<const MatrixX>& residual, TrainingMatrixX& hessian, TrainingMatrixX& b);
+
+        /** Gauss-Newton system of the simultaneous algorithm, including appearance parameters */
+        void linearizeSimultaneous(const SampleSet& set, const Eigen::Ref<const MatrixX>& errorImage, TrainingMatrixX& hessian, TrainingMatrixX& b);
+
+        /** solve the damped Gauss-Newton system of the workspace and apply the update to the given parameters */
+        void solveDampedUpdate(Affine2& warp, RowVectorX& shapeParams, RowVectorX& appearanceParams);
+
+        /** apply a parameter update to the given parameters */
+        void applyUpdate(const MatrixX& delta, Affine2& warp, RowVectorX& shapeParams, RowVectorX& appearanceParams) const;
+
     public:
 
         /** Constructor */
-        Matcher2(const aam::ActiveAppearanceModel& model);
+        Matcher2(const aam::ActiveAppearanceModel& model, Algorithm algorithm = PROJECT_OUT);
 
-        /** Initialize the matching (i.e. pre-compute various entities) */
-        void init(const cv::Mat& img, Scalar x, Scalar y, Scalar scaling, aam::RowVectorX& shapeParams, aam::RowVectorX& appearanceParams);
+        /** Initialize the matching (i.e. pre-compute various entities). Returns false if the appearance 
+            modes of the model are linearly dependent on its samples, no steps must be performed then. */
+        bool init(const cv::Mat& img, Scalar x, Scalar y, Scalar scaling, aam::RowVectorX& shapeParams, aam::RowVectorX& appearanceParams);
 
-        /** match the active appearance model to the given image */
+        /** Initialize the matching at the given global transform, e.g. a candidate of GlobalPoseSearch. 
+            Returns false if initialization failed, see above. */
+        bool init(const cv::Mat& img, const Affine2& pose, aam::RowVectorX& shapeParams, aam::RowVectorX& appearanceParams);
+
+        /** Restart matching at the given pose and parameters without repeating any pre-computation */
+        void reset(Scalar x, Scalar y, Scalar scaling, const aam::RowVectorX& shapeParams, const aam::RowVectorX& appearanceParams);
+
+        /** perform a single Levenberg-Marquardt step. The Gauss-Newton update is damped until it 
+            decreases the error, the damping is carried over to the next step. */
         void step();
 
         /** returns the current warp */
         Affine2 getCurrentGlobalTransform();
 
-        /** returns the current shape params */
-        MatrixX getCurrentShapeParams();
-
-        /** returns the current appearance params */
-        MatrixX getCurrentAppearanceParams();
+        /** returns the current shape params, valid until the next step */
+        const RowVectorX& getCurrentShapeParams() const;
+
+        /** returns the current appearance params, valid until the next step */
+        const RowVectorX& getCurrentAppearanceParams() const;
+
+        /** returns the root mean squared error measured in the last step (before its update was applied). 
+            The simultaneous algorithm measures the error with respect to the current appearance instance, 
+            the project-out algorithm with respect to the mean appearance. */
+        Scalar getCurrentError();
+
+        /** Root mean squared error at the current parameters on all samples, whichever subsets steps use. 
+            Measured like the error minimized by the algorithm: with respect to the current appearance 
+            instance for the simultaneous algorithm, after projecting out appearance variation for the 
+            project-out algorithm (appearance parameters estimated robustly if setRobustError was called). 
+            Errors of matchers of the same model are comparable, parameters are not changed. */
+        Scalar measureCurrentError();
+
+        /** Bind a new image to match against, keeping all pre-computed entities and the current parameters.
+            The image is bound by reference and must not be modified while matching. */
+        void setImage(const cv::Mat& img);
+
+        /** Bind only the region of the image around the bounding box of the current shape instance
+            enlarged by margin pixels. No pixels are copied. Whenever the shape instance moves closer 
+            than one pixel to the border of the region while fitting, the region is re-derived from the 
+            current bounding box, so that results equal those of fitting on the full image. Coordinates 
+            (pose) remain relative to the full image. */
+        void setImageROI(const cv::Mat& img, int margin);
+
+        /** set the current warp, e.g. to warm-start matching from a predicted pose */
+        void setCurrentGlobalTransform(const Affine2& warp);
+
+        /** set the current shape params */
+        void setCurrentShapeParams(const RowVectorX& shapeParams);
+
+        /** set the current appearance params */
+        void setCurrentAppearanceParams(const RowVectorX& appearanceParams);
+
+        /** Fit on subsets of about nbSamples samples instead of all samples to reduce per-iteration cost, 
+            e.g. during early iterations. Hessians are pre-computed per subset. When more than one subset 
+            is requested, each step uses one of them chosen at random. nbSamples is raised to at least 
+            the number of parameters. Subsets on which the appearance modes are linearly dependent are 
+            dropped; if no subset remains, all samples are used. Call after init. */
+        void setSampleSubsets(SampleSelection selection, int nbSamples, int nbSubsets = 1);
+
+        /** Fit on all samples again, e.g. for final refinement */
+        void useAllSamples();
+
+        /** Seed the random number generator choosing subsets per step. Copies of a matcher continue 
+            the same random sequence unless reseeded. */
+        void setSeed(unsigned int seed);
+
+        /** Weight residuals by an M-estimator to reduce the influence of outliers such as occlusions.
+            Residuals are normalized by scale (gray values); a scale of zero estimates it per step from 
+            the median absolute residual. The weighted Hessian is assembled from pre-computed per triangle 
+            contributions, assuming weights to be constant per triangle. Weights are derived from the residual 
+            left after removing the appearance instance, so that appearance variation explained by the 
+            model is not taken for outliers. Appearance parameters are estimated robustly as well, refined 
+            by a few reweighting iterations per step. Applies to the project-out 
+            algorithm only, the simultaneous algorithm always uses least squares. */
+        void setRobustError(RobustError error, Scalar scale = 0);
     };
 
 }
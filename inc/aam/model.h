@@ -25,7 +25,13 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace aam {
     
-    /** Training active appearance model. */
+    /** Training active appearance model. 
+     
+        The model holds a single representation in runtime precision (aam::Scalar). Training 
+        computes it in aam::TrainingScalar and narrows the results, serialized models are 
+        stored in double precision and converted to aam::Scalar when loaded. No copy in 
+        training precision is kept alongside.
+     */
     class ActiveAppearanceModel {
     public:
         
@@ -51,7 +57,10 @@ namespace aam {
         RowVectorX shapeModeWeights;
         
         /** Affine transform to be applied to normalized shape coordinates 
-            to bring coordinates back to training image size.
+            to bring coordinates back to training image size. Barycentric sample 
+            positions are located on pixel centers of the mean shape in these 
+            coordinates, so their scale sets the appearance resolution (see 
+            Trainer::setAppearanceResolution).
          */
         Affine2 shapeTransformToTrainingData;
         
@@ -73,9 +82,11 @@ namespace aam {
         MatrixX barycentricSamplePositions;
         
         /** 1xN Mean appearance vector.
-            Given in normalized shape coordinates.
+            Given in normalized shape coordinates. Color appearances store the 
+            channels of each sample position interleaved, see appearanceChannels.
             Format:
                 i0, i1, i2, ...
+                r0, g0, b0, r1, g1, b1, ... (color)
          */
         RowVectorX appearanceMean;
         
@@ -93,20 +104,51 @@ namespace aam {
         */
         RowVectorX appearanceModeWeights;
 
+        /** Nx2 gradient of the mean appearance at sample positions. Precomputed
+            during training on the sample grid of the mean shape. Derivatives are
+            given with respect to training data coordinates (see shapeTransformToTrainingData).
+            Color models store one row per sample position and channel.
+            Format:
+                dx0, dy0
+                dx1, dy1
+         */
+        MatrixX appearanceMeanGradient;
+
         /** Save model to file */
         bool save(const char *path) const;
         
         /** Load model from file */
         bool load(const char *path);
 
-        /** Draw the given model instance (shape only) to an image */
-        void renderShapeInstanceToImage(cv::Mat& image, MatrixX trafo, RowVectorX shapeParameters);
+        /** Reconstruct the shape instance of the given parameters in normalized shape coordinates.
+            Computed as a single product into the preallocated 1xN shape. */
+        void reconstructShape(Eigen::Ref<const RowVectorX> shapeParameters, Eigen::Ref<RowVectorX> shape) const;
+
+        /** Project a shape given in normalized shape coordinates onto the shape modes.
+            Computed as products into the preallocated 1xM shapeParameters. */
+        void projectShape(Eigen::Ref<const RowVectorX> shape, Eigen::Ref<RowVectorX> shapeParameters) const;
+
+        /** Reconstruct the appearance instance of the given parameters.
+            Computed as a single product into the preallocated 1xN appearance. */
+        void reconstructAppearance(Eigen::Ref<const RowVectorX> appearanceParameters, Eigen::Ref<RowVectorX> appearance) const;
+
+        /** Project an appearance onto the appearance modes.
+            Computed as products into the preallocated 1xM appearanceParameters. */
+        void projectAppearance(Eigen::Ref<const RowVectorX> appearance, Eigen::Ref<RowVectorX> appearanceParameters) const;
+
+        /** Draw the given model instance (shape only) to an image. An empty trafo draws in training data coordinates. */
+        void renderShapeInstanceToImage(cv::Mat& image, Eigen::Ref<const MatrixX> trafo, Eigen::Ref<const RowVectorX> shapeParameters) const;
+
+        /** Draw the given model instance (including shape and texture) to an image. An empty trafo draws in training data coordinates. */
+        void renderAppearanceInstanceToImage(cv::Mat& image, Eigen::Ref<const MatrixX> trafo, Eigen::Ref<const RowVectorX> shapeParameters, Eigen::Ref<const RowVectorX> appearanceParameters, bool drawShape = true) const;
 
-        /** Draw the given model instance (including shape and texture) to an image */
-        void renderAppearanceInstanceToImage(cv::Mat& image, MatrixX trafo, RowVectorX shapeParameters, RowVectorX appearanceParameters, bool drawShape = true);
+        /** Get the cartesian pixel coordinates of all samples from the given shape parameters. Only the vertices 
+            of one triangle at a time are reconstructed, so no memory is allocated once coordinates has reached 
+            its size. */
+        void getCartesianPixelCoordinates(Eigen::Ref<const MatrixX> trafo, Eigen::Ref<const RowVectorX> shapeParameters, std::vector<aam::RowVector2>& coordinates) const;
 
-        /** Get the cartesian pixel coordinates from the given shape Parameters */
-        void getCartesianPixelCoordinates(MatrixX trafo, RowVectorX shapeParameters, std::vector<aam::RowVector2>& coordinates);
+        /** Number of channels per sample position of the appearance, 1 for gray and 3 for color models */
+        int appearanceChannels() const;
 
         /** Keep only the numModes most relevant modes of shape variation */
         void setNumShapeModes(int numModes);
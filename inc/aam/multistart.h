@@ -0,0 +1,179 @@
+/**
+This file is part of Active Appearance Models (AAM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AAM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AAM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AAM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAM_MULTISTART_H
+#define AAM_MULTISTART_H
+
+#include <aam/fwd.h>
+#include <aam/types.h>
+#include <aam/matcher.h>
+
+namespace aam {
+
+    /** Fits an active appearance model from multiple starting poses in parallel.
+
+        Starting poses are laid out on a regular grid of positions, each combined with a list 
+        of scalings. All hypotheses are fitted for a few coarse steps, optionally on random 
+        subsets of samples. Hypotheses with the largest error, measured on all samples at their 
+        current parameters, are then pruned, and only the best ones are refined on all samples. 
+        Hypotheses are copies of a single matcher, so model dependent entities are pre-computed 
+        only once.
+     */
+    class MultiStartMatcher {
+    public:
+
+        /** Constructor */
+        MultiStartMatcher(const ActiveAppearanceModel& model, Matcher2::Algorithm algorithm = Matcher2::PROJECT_OUT);
+
+        /** Start from nx by ny positions placed at the cell centers of a regular grid over region */
+        void setPositionGrid(const cv::Rect& region, int nx, int ny);
+
+        /** Set the scalings (relative to the training data) to start from at each position */
+        void setScalings(const std::vector<Scalar>& scalings);
+
+        /** Set the number of coarse steps performed by all hypotheses and the fraction of samples 
+            used for coarse steps. A fraction of one uses all samples. */
+        void setCoarseFitting(int steps, Scalar sampleFraction);
+
+        /** Set the number of hypotheses kept after the coarse steps and the number of refinement 
+            steps performed on them */
+        void setRefinement(int hypotheses, int steps);
+
+        /** Set the base seed of random subset selection. Hypothesis i is seeded with seed + i, 
+            so that hypotheses draw different subsets. */
+        void setSeed(unsigned int seed);
+
+        /** Fit the model to the image.
+
+            \param img image to fit to
+            \param pose receives the global transform of the best hypothesis
+            \param shapeParams receives the shape parameters of the best hypothesis
+            \param appearanceParams receives the appearance parameters of the best hypothesis
+            \return root mean squared error of the best hypothesis at its final parameters (see 
+                    Matcher2::measureCurrentError), NaN if it diverged or the matcher could not be 
+                    initialized (see Matcher2::init)
+         */
+        Scalar fit(const cv::Mat& img, Affine2& pose, RowVectorX& shapeParams, RowVectorX& appearanceParams);
+
+    private:
+
+        /** matcher all hypotheses are copied from */
+        Matcher2 _prototype;
+
+        /** matcher coarse hypotheses are copied from, fitting on sample subsets */
+        Matcher2 _coarsePrototype;
+
+        /** number of samples of the model */
+        MatrixX::Index _nSamples;
+
+        /** number of shape parameters */
+        MatrixX::Index _nShapeParams;
+
+        /** number of appearance parameters */
+        MatrixX::Index _nAppearanceParams;
+
+        /** whether the prototypes have been initialized */
+        bool _initialized;
+
+        /** region covered by starting positions */
+        cv::Rect _region;
+
+        /** number of starting positions in x and y */
+        int _nx, _ny;
+
+        /** scalings used at each starting position */
+        std::vector<Scalar> _scalings;
+
+        /** number of coarse steps */
+        int _coarseSteps;
+
+        /** fraction of samples used for coarse steps */
+        Scalar _coarseSampleFraction;
+
+        /** number of hypotheses refined */
+        int _refineHypotheses;
+
+        /** number of refinement steps */
+        int _refineSteps;
+
+        /** base seed of random subset selection */
+        unsigned int _seed;
+    };
+
+    /** Result of fitting a single model instance */
+    struct InstanceFit {
+        /** global transform */
+        Affine2 pose;
+
+        /** shape parameters */
+        RowVectorX shapeParams;
+
+        /** appearance parameters */
+        RowVectorX appearanceParams;
+
+        /** root mean squared error measured in the last step */
+        Scalar error;
+    };
+
+    /** Fits multiple instances of an active appearance model in a single image.
+
+        Each instance starts from its own pose, e.g. one per detected face. All instances 
+        are copies of a single matcher bound to the image once, so model dependent entities 
+        are pre-computed only once and shared. The independent fits run in parallel.
+     */
+    class MultiInstanceMatcher {
+    public:
+
+        /** Constructor */
+        MultiInstanceMatcher(const ActiveAppearanceModel& model, Matcher2::Algorithm algorithm = Matcher2::PROJECT_OUT);
+
+        /** Set the number of steps performed per instance */
+        void setSteps(int steps);
+
+        /** Fit the model at each of the given poses.
+
+            \param img image to fit to
+            \param poses initial global transforms, one per instance
+            \param results receives one result per instance in the order of poses
+            \return false, leaving results empty, if the matcher could not be initialized (see Matcher2::init)
+         */
+        bool fit(const cv::Mat& img, const std::vector<Affine2>& poses, std::vector<InstanceFit>& results);
+
+    private:
+
+        /** matcher all instances are copied from */
+        Matcher2 _prototype;
+
+        /** number of shape parameters */
+        MatrixX::Index _nShapeParams;
+
+        /** number of appearance parameters */
+        MatrixX::Index _nAppearanceParams;
+
+        /** whether the prototype has been initialized */
+        bool _initialized;
+
+        /** number of steps per instance */
+        int _steps;
+    };
+
+}
+
+#endif
\ No newline at end of file
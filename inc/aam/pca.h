@@ -27,11 +27,20 @@ namespace aam {
    
     /** Compute PCA transform for given data set.
      
+        \tparam T Scalar type used for accumulation and eigen-decomposition. Instantiated for float and double.
         \param data MxN matrix with M features in N dimensions in rows
         \param mean 1xM matrix receiving the data mean
         \param basis MxM matrix with PCA normalized vectors in columns sorted by ascending eigenvalues.
         \param weights 1xM matrix containing the eigenvalues sorted in ascending order.
      */
+    template<class T>
+    void computePCA(
+        Eigen::Ref<const typename AamMatrixTraits<T>::MatrixType> data, 
+        typename AamMatrixTraits<T, 1, Eigen::Dynamic>::MatrixType &mean, 
+        typename AamMatrixTraits<T>::MatrixType &basis, 
+        typename AamMatrixTraits<T, 1, Eigen::Dynamic>::MatrixType &weights);
+
+    /** Compute PCA transform for given data set in aam::Scalar precision. */
     void computePCA(Eigen::Ref<const MatrixX> data, RowVectorX &mean, MatrixX &basis, RowVectorX &weights);
     
     /** Compute the PCA subspace dimensionality for a given tolerated loss.
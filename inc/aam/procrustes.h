@@ -37,10 +37,17 @@ namespace aam {
         "A brief introduction to statistical shape analysis." 
         Informatics and Mathematical Modelling, Technical University of Denmark, DTU 15 (2002): 11.
      
+        \tparam T Scalar type used for computation. Instantiated for float and double.
         \param X Nx2 Target shape consisting of N two-dimensional measurements.
         \param Y Nx2 Input shape consisting of N two-dimensional measurements. Modified in place.
         \return Normalized distance between X and transformed Y.
      */
+    template<class T>
+    T procrustes(
+        Eigen::Ref<const typename AamMatrixTraits<T, 1, Eigen::Dynamic>::MatrixType> X, 
+        Eigen::Ref<typename AamMatrixTraits<T, 1, Eigen::Dynamic>::MatrixType> Y);
+
+    /** Compute Procrustes shape normalization in aam::Scalar precision. */
     Scalar procrustes(Eigen::Ref<const RowVectorX> X, Eigen::Ref<RowVectorX> Y);
 
     /** Compute Procrustes shape normalization of n-shapes.
@@ -56,10 +63,16 @@ namespace aam {
         "A brief introduction to statistical shape analysis."
         Informatics and Mathematical Modelling, Technical University of Denmark, DTU 15 (2002): 11.
 
+        \tparam T Scalar type used for computation. Instantiated for float and double.
         \param X NxM Shape Matrix
         \param maxIteraions Maximum number of iterations to perform normalization.
         \return Normalized distance between mean shape and reference shape in last iteration.
     */
+    template<class T>
+    typename AamMatrixTraits<T>::MatrixType generalizedProcrustes(
+        Eigen::Ref<const typename AamMatrixTraits<T>::MatrixType> X, int maxIterations);
+
+    /** Compute Procrustes shape normalization of n-shapes in aam::Scalar precision. */
     MatrixX generalizedProcrustes(Eigen::Ref<const MatrixX> X, int maxIterations);
 
 }
@@ -92,6 +92,39 @@ namespace aam {
         Eigen::Ref<const RowVectorXi> triangleIds,
         Eigen::Ref<const MatrixX> barycentricPoints,
         std::vector<RowVector2>& cartesianPoints);
+
+    /** Compute the gradient of a shape image.
+
+        The gradient is computed directly on the grid of sample positions without rendering
+        an image. Sample positions are expected to be located on pixel centers of the given
+        shape, as generated by rasterizeShape. Derivatives are computed by a Sobel stencil 
+        over the 8-neighborhood of each sample, normalized to units of value per pixel. Samples 
+        lacking any neighbor (i.e. at the shape border) receive a zero gradient. Values with multiple 
+        channels per sample are given interleaved, the gradient then has one row per sample and channel.
+
+        \param shape List of points in interleaved format x0, y0, x1, y1, ... as passed to rasterizeShape.
+        \param triangleIds List of triangle vertices in triplets.
+        \param barycentricSamplePositions Nx3 matrix containing sample position stored as triplets of triangleId, alpha, beta per row.
+        \param values 1xN or 1x(N*C) values per sample position.
+        \param gradient Nx2 or (N*C)x2 matrix receiving the derivatives with respect to x and y per row.
+    */
+    void computeShapeImageGradient(
+        Eigen::Ref<const RowVectorX> shape,
+        Eigen::Ref<const RowVectorXi> triangleIds,
+        Eigen::Ref<const MatrixX> barycentricSamplePositions,
+        Eigen::Ref<const RowVectorX> values,
+        MatrixX &gradient);
+
+#ifndef AAM_DOUBLE_PRECISION
+    /** Compute the gradient of a shape image in TrainingScalar precision. With AAM_DOUBLE_PRECISION 
+        both precisions coincide and the overload above applies. */
+    void computeShapeImageGradient(
+        Eigen::Ref<const RowVectorX> shape,
+        Eigen::Ref<const RowVectorXi> triangleIds,
+        Eigen::Ref<const MatrixX> barycentricSamplePositions,
+        Eigen::Ref<const RowVectorX> values,
+        TrainingMatrixX &gradient);
+#endif
     
 }
 
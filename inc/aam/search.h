@@ -0,0 +1,121 @@
+/**
+This file is part of Active Appearance Models (AAM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AAM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AAM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AAM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAM_SEARCH_H
+#define AAM_SEARCH_H
+
+#include <aam/fwd.h>
+#include <aam/types.h>
+#include <aam/model.h>
+
+namespace aam {
+
+    /** Candidate pose found by global pose search */
+    struct PoseCandidate {
+        /** global shape transform, suitable as current warp of a matcher */
+        Affine2 pose;
+
+        /** normalized cross correlation of the template at this pose, in [-1, 1] */
+        Scalar score;
+    };
+
+    /** Coarse global search for the pose of a model instance in an image.
+
+        The mean appearance is rendered as template at a number of scalings and rotations.
+        Templates are located by normalized cross correlation (cv::matchTemplate, which 
+        correlates in the frequency domain for large templates) on the coarsest level of an 
+        image pyramid. The best candidates are then followed down the pyramid within a small
+        window per level. Template pixels outside of the shape are set to the template mean. 
+        They add nothing to the correlation itself, but the image pixels they cover still enter 
+        the normalization of the response by the image window variance. 
+        
+        The resulting poses are meant to initialize gradient based fitting, see Matcher2::init.
+     */
+    class GlobalPoseSearch {
+    public:
+
+        /** Constructor */
+        GlobalPoseSearch(const ActiveAppearanceModel& model);
+
+        /** Set the scalings (relative to the training data) to search for */
+        void setScalings(const std::vector<Scalar>& scalings);
+
+        /** Set the rotations in degrees to search for */
+        void setRotations(const std::vector<Scalar>& degrees);
+
+        /** Set the number of pyramid levels above the input image. The exhaustive search is
+            performed on the coarsest level. */
+        void setPyramidLevels(int levels);
+
+        /** Set the maximum number of candidates returned */
+        void setMaxCandidates(int n);
+
+        /** Search the image for model instances.
+
+            \param img single channel image
+            \param candidates receives candidate poses sorted by decreasing score
+         */
+        void search(const cv::Mat& img, std::vector<PoseCandidate>& candidates);
+
+    private:
+
+        /** Rendered template */
+        struct Template {
+            /** template image, CV_32F */
+            cv::Mat image;
+
+            /** pixel position of the origin of normalized shape coordinates */
+            cv::Point2f center;
+        };
+
+        /** Get the template for the given scaling, rotation and pyramid level */
+        const Template& getTemplate(size_t scaling, size_t rotation, int level);
+
+        /** Affine transform from normalized shape coordinates to training data coordinates */
+        Affine2 _shapeTransform;
+
+        /** mean appearance rendered in training data coordinates, CV_32F */
+        cv::Mat _meanAppearance;
+
+        /** mask of pixels covered by the mean shape, CV_8U */
+        cv::Mat _meanMask;
+
+        /** pixel position of the origin of normalized shape coordinates in the mean appearance */
+        cv::Point2f _meanCenter;
+
+        /** scalings searched */
+        std::vector<Scalar> _scalings;
+
+        /** rotations searched in degrees */
+        std::vector<Scalar> _rotations;
+
+        /** number of pyramid levels */
+        int _levels;
+
+        /** maximum number of candidates */
+        int _maxCandidates;
+
+        /** cached templates per level, scaling and rotation */
+        std::vector<Template> _templates;
+    };
+
+}
+
+#endif
\ No newline at end of file
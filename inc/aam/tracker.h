@@ -0,0 +1,108 @@
+/**
+This file is part of Active Appearance Models (AAM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AAM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AAM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AAM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AAM_TRACKER_H
+#define AAM_TRACKER_H
+
+#include <aam/fwd.h>
+#include <aam/types.h>
+#include <aam/matcher.h>
+
+namespace aam {
+
+    /** Tracks an active appearance model through a sequence of frames.
+
+        Model dependent entities are pre-computed once when tracking starts. Each following
+        frame only rebinds the image and warm-starts the matcher from the pose, shape and 
+        appearance parameters of the previous frame. Optionally the pose is predicted using 
+        a constant velocity model. Use reset to provide the initial pose before fitting the
+        first frame or to recover from a lost track.
+     */
+    class Tracker {
+    public:
+
+        /** Constructor */
+        Tracker(const ActiveAppearanceModel& model, Matcher2::Algorithm algorithm = Matcher2::PROJECT_OUT);
+
+        /** Set the number of matching steps performed per frame */
+        void setStepsPerFrame(int steps);
+
+        /** Enable or disable constant velocity prediction of the pose */
+        void setPosePrediction(bool enable);
+
+        /** Bind only the region of each frame around the (predicted) shape instance enlarged by 
+            margin pixels, see Matcher2::setImageROI. A negative margin binds full frames. */
+        void setImageMargin(int margin);
+
+        /** Restart tracking at the given pose with zero shape and appearance parameters. 
+            Takes effect with the next call to fit. 
+         */
+        void reset(Scalar x, Scalar y, Scalar scaling);
+
+        /** Fit the model to the next frame.
+
+            \param img next frame
+            \param pose receives the global transform of the fitted model
+            \param shapeParams receives the shape parameters of the fitted model
+            \param appearanceParams receives the appearance parameters of the fitted model
+            \return root mean squared error measured in the last matching step, NaN if the matcher 
+                    could not be initialized (see Matcher2::init)
+         */
+        Scalar fit(const cv::Mat& img, Affine2& pose, RowVectorX& shapeParams, RowVectorX& appearanceParams);
+
+    private:
+
+        /** the matcher carrying pre-computed entities and current parameters */
+        Matcher2 _matcher;
+
+        /** number of shape parameters */
+        MatrixX::Index _nShapeParams;
+
+        /** number of appearance parameters */
+        MatrixX::Index _nAppearanceParams;
+
+        /** number of matching steps per frame */
+        int _stepsPerFrame;
+
+        /** whether to predict the pose of the next frame */
+        bool _predictPose;
+
+        /** margin of the bound region around the shape instance, negative for full frames */
+        int _imageMargin;
+
+        /** whether the matcher has been initialized */
+        bool _initialized;
+
+        /** whether a reset is pending */
+        bool _resetPending;
+
+        /** initial pose used on reset */
+        Scalar _x, _y, _scaling;
+
+        /** number of frames fitted since the last reset */
+        int _framesTracked;
+
+        /** fitted poses of the last two frames */
+        Affine2 _lastPose, _currentPose;
+    };
+
+}
+
+#endif
\ No newline at end of file
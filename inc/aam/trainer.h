@@ -23,6 +23,7 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <aam/fwd.h>
 #include <aam/types.h>
+#include <functional>
 
 namespace aam {
    
@@ -32,18 +33,47 @@ namespace aam {
         /** Constructor */
         Trainer(const TrainingSet& trainingSet);
 
-        /** train the active appearance model */
-        void train(ActiveAppearanceModel& model);
+        /** Set the resolution of the appearance. The mean shape is scaled such that its larger side
+            spans the given number of pixels before it is rasterized. Zero (the default) uses the 
+            scale of the aligned training shapes. Clears any sample count set. */
+        void setAppearanceResolution(Scalar pixels);
+
+        /** Set the approximate number of appearance samples. The mean shape is scaled such that its 
+            area roughly covers the given number of pixels before it is rasterized. Zero (the default) 
+            uses the scale of the aligned training shapes. Clears any resolution set. */
+        void setAppearanceSamples(int samples);
+
+        /** train the active appearance model. Returns false, leaving the model incomplete, if the 
+            training set holds fewer images than shapes. */
+        bool train(ActiveAppearanceModel& model);
+
+        /** train the active appearance model on images handed out by the loader, which must have been
+            opened on the training set of this trainer. Appearances are sampled while subsequent images 
+            are being decoded. Returns false, leaving the model incomplete, if an image could not be 
+            loaded (see AsfTrainingSetLoader::failed). */
+        bool train(ActiveAppearanceModel& model, AsfTrainingSetLoader& loader);
 
         static void createTriangulation(TrainingSet& trainingSet);
 
     private:
+        /** train on images requested in order of the training examples. Returns false if an image 
+            is not available. */
+        bool train(ActiveAppearanceModel& model, const std::function<bool(cv::Mat&)>& nextImage);
+
         /** Normalize shape to unit size and move to origin */
         Affine2 normalizeShape(Eigen::Ref<RowVectorX> shape, Eigen::Ref<RowVectorX> weights) const;
 
+        /** Scale shape about its centroid to the requested appearance resolution */
+        void scaleShapeToAppearanceResolution(Eigen::Ref<RowVectorX> shape, Eigen::Ref<RowVectorX> weights) const;
 
         /** the training data from which the trainer builds the AAM */
         const TrainingSet &_ts;
+
+        /** target extent of the mean shape in pixels, zero if unused */
+        Scalar _appearanceResolution;
+
+        /** target number of appearance samples, zero if unused */
+        int _appearanceSamples;
     };
 
 }
@@ -22,6 +22,7 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #define AAM_TRAININGSET_H
 
 #include <aam/types.h>
+#include <memory>
 
 namespace aam {
     
@@ -32,6 +33,7 @@ namespace aam {
         cv::Mat contour;  // optional: contours defined on the object (this data is just for visualization, not needed for actual AAM)
         aam::MatrixX shapes;    // NxM matrix with N (nb. rows) = number of training examples, M (nb. cols) = number of coordinates per training shape
         aam::RowVectorXi triangles; // the triangles that span the shapes
+        std::shared_ptr<const void> storage; // optional: keeps memory alive that images refer to, e.g. a memory mapped cache (see loadTrainingSetCache)
     };
     
 }
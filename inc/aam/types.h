@@ -28,9 +28,21 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace aam {
    
-    /** Precision */
+    /** Precision used at runtime (model storage, fitting).
+        Define AAM_DOUBLE_PRECISION to switch to double precision.
+     */
+#ifdef AAM_DOUBLE_PRECISION
+    typedef double Scalar;
+#else
     typedef float Scalar;
-    
+#endif
+
+    /** Precision used to accumulate numerically sensitive computations
+        such as Procrustes analysis, PCA and Hessians. Results are converted
+        to aam::Scalar afterwards.
+     */
+    typedef double TrainingScalar;
+
     /** Generic MxN matrix set to storage order compatible with OpenCV matrices. */
     typedef AamMatrixTraits<Scalar>::MatrixType MatrixX;
 
@@ -54,6 +66,12 @@ namespace aam {
     
     /** Affine matrix in compact storage for row-vector layout. */
     typedef AamMatrixTraits<Scalar, 3, 2>::MatrixType Affine2;
+
+    /** Generic MxN matrix in training precision. */
+    typedef AamMatrixTraits<TrainingScalar>::MatrixType TrainingMatrixX;
+
+    /** Generic 1xM row vector in training precision. */
+    typedef AamMatrixTraits<TrainingScalar, 1, Eigen::Dynamic>::MatrixType TrainingRowVectorX;
 }
 
 #endif
\ No newline at end of file
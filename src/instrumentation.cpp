@@ -0,0 +1,120 @@
+/**
+This file is part of Active Appearance Models (AAM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AAM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AAM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AAM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <aam/instrumentation.h>
+#include <atomic>
+#include <sstream>
+
+namespace aam {
+    namespace instrumentation {
+
+        namespace {
+
+            const char *stageNames[NUM_STAGES] = {
+                "train_procrustes",
+                "train_rasterize",
+                "train_sampling",
+                "train_pca",
+                "fit_step",
+                "fit_trial",
+                "fit_coordinates",
+                "fit_sampling",
+                "fit_residual",
+                "fit_update",
+                "load_parse",
+                "load_decode"
+            };
+
+            /** Counters of a stage, updated without locking */
+            struct StageCounters {
+                std::atomic<uint64_t> calls;
+                std::atomic<uint64_t> items;
+                std::atomic<int64_t> totalTicks;
+                std::atomic<int64_t> maxTicks;
+            };
+
+            StageCounters counters[NUM_STAGES];
+
+            double toSeconds(int64_t ticks) {
+                typedef std::chrono::steady_clock::period Period;
+                return (double)ticks * Period::num / Period::den;
+            }
+        }
+
+        void record(Stage stage, std::chrono::steady_clock::duration elapsed) {
+            StageCounters &c = counters[stage];
+            const int64_t ticks = (int64_t)elapsed.count();
+
+            c.calls.fetch_add(1, std::memory_order_relaxed);
+            c.totalTicks.fetch_add(ticks, std::memory_order_relaxed);
+
+            int64_t prevMax = c.maxTicks.load(std::memory_order_relaxed);
+            while (ticks > prevMax && !c.maxTicks.compare_exchange_weak(prevMax, ticks, std::memory_order_relaxed));
+        }
+
+        void count(Stage stage, uint64_t items) {
+            counters[stage].items.fetch_add(items, std::memory_order_relaxed);
+        }
+
+        Report report() {
+            Report r;
+#ifdef AAM_INSTRUMENTATION
+            r.enabled = true;
+#else
+            r.enabled = false;
+#endif
+            for (int i = 0; i < NUM_STAGES; ++i) {
+                StageStatistics &s = r.stages[i];
+                s.name = stageNames[i];
+                s.calls = counters[i].calls.load(std::memory_order_relaxed);
+                s.items = counters[i].items.load(std::memory_order_relaxed);
+                s.totalSeconds = toSeconds(counters[i].totalTicks.load(std::memory_order_relaxed));
+                s.maxSeconds = toSeconds(counters[i].maxTicks.load(std::memory_order_relaxed));
+            }
+            return r;
+        }
+
+        void reset() {
+            for (int i = 0; i < NUM_STAGES; ++i) {
+                counters[i].calls = 0;
+                counters[i].items = 0;
+                counters[i].totalTicks = 0;
+                counters[i].maxTicks = 0;
+            }
+        }
+
+        std::string Report::toJson() const {
+            std::ostringstream json;
+            json.imbue(std::locale::classic());
+            json << "{\"enabled\":" << (enabled ? "true" : "false") << ",\"stages\":{";
+            for (int i = 0; i < NUM_STAGES; ++i) {
+                const StageStatistics &s = stages[i];
+                json << (i > 0 ? "," : "") << "\"" << s.name << "\":{"
+                    << "\"calls\":" << s.calls
+                    << ",\"items\":" << s.items
+                    << ",\"total_ms\":" << s.totalSeconds * 1000
+                    << ",\"max_ms\":" << s.maxSeconds * 1000
+                    << "}";
+            }
+            json << "}}";
+            return json.str();
+        }
+    }
+}
\ No newline at end of file
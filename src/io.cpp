@@ -22,141 +22,616 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #include <aam/types.h>
 #include <aam/trainingset.h>
 #include <aam/views.h>
+#include <aam/instrumentation.h>
+
+#include <aam/io/serialization.h>
 
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <opencv2/opencv.hpp>
 
-bool parseAsfFile(const std::string& fileName, aam::RowVectorX &coords, cv::Mat& contours) {
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    inline bool isBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline void skipBlanks(const char *&p, const char *end) {
+        while (p != end && isBlank(*p)) ++p;
+    }
+
+    inline const char *endOfLine(const char *p, const char *end) {
+        while (p != end && *p != '\n') ++p;
+        return p;
+    }
+
+    /** Scan a signed decimal integer followed by a blank or the end of line. */
+    bool scanInt(const char *&p, const char *end, int &value) {
+        skipBlanks(p, end);
+        bool negative = false;
+        if (p != end && (*p == '-' || *p == '+')) {
+            negative = (*p++ == '-');
+        }
+
+        const char *digits = p;
+        long v = 0;
+        while (p != end && *p >= '0' && *p <= '9' && v < 100000000) {
+            v = v * 10 + (*p++ - '0');
+        }
+
+        if (p == digits || (p != end && !isBlank(*p) && *p != '\n'))
+            return false;
+
+        value = (int)(negative ? -v : v);
+        return true;
+    }
+
+    /** Scan a decimal real number with optional fraction and exponent followed by a blank or the end of line. */
+    bool scanReal(const char *&p, const char *end, aam::Scalar &value) {
+        skipBlanks(p, end);
+        bool negative = false;
+        if (p != end && (*p == '-' || *p == '+')) {
+            negative = (*p++ == '-');
+        }
+
+        double mantissa = 0;
+        int exponent = 0;
+        int nDigits = 0;
+        while (p != end && *p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p++ - '0');
+            ++nDigits;
+        }
+        if (p != end && *p == '.') {
+            ++p;
+            while (p != end && *p >= '0' && *p <= '9') {
+                mantissa = mantissa * 10 + (*p++ - '0');
+                --exponent;
+                ++nDigits;
+            }
+        }
+        if (nDigits == 0)
+            return false;
+
+        if (p != end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            int e;
+            if (!scanInt(p, end, e))
+                return false;
+            exponent += e;
+        }
+
+        if (p != end && !isBlank(*p) && *p != '\n')
+            return false;
+
+        double v = exponent < 0 ? mantissa / std::pow(10.0, -exponent) : mantissa * std::pow(10.0, exponent);
+        value = (aam::Scalar)(negative ? -v : v);
+        return true;
+    }
+}
+
+aam::AsfParseResult aam::parseAsf(const char *begin, const char *end, RowVectorX &coords, cv::Mat &contour) {
+
+    // Lines are either comments starting with '#', the number of points, one line per point 
+    // '<path> <type> <x> <y> <id> <from> <to>' or the file name of the host image.
 
+    int nPoints = -1;
     int landmarkCount = 0;
 
-    std::ifstream file(fileName);
+    const char *p = begin;
+    while (p != end) {
+        const char *eol = endOfLine(p, end);
+
+        skipBlanks(p, eol);
+        if (p != eol && *p != '#') {
+            if (nPoints < 0) {
+                if (!scanInt(p, eol, nPoints) || nPoints <= 0)
+                    return ASF_INVALID_POINT_COUNT;
+
+                if (coords.cols() != nPoints * 2)
+                    coords.resize(1, nPoints * 2);
+                contour.create(nPoints, 3, CV_32SC1);
+            }
+            else if (landmarkCount < nPoints) {
+                int path, type;
+                aam::Scalar x, y;
+                int *c = contour.ptr<int>(landmarkCount);
+
+                if (!scanInt(p, eol, path) || !scanInt(p, eol, type) ||
+                    !scanReal(p, eol, x) || !scanReal(p, eol, y) ||
+                    !scanInt(p, eol, c[0]) || !scanInt(p, eol, c[1]) || !scanInt(p, eol, c[2]))
+                    return ASF_INVALID_POINT;
+
+                coords(0, landmarkCount * 2 + 0) = x;
+                coords(0, landmarkCount * 2 + 1) = y;
+                landmarkCount++;
+            }
+            // else: file name of the host image, ignored
+        }
+
+        p = (eol == end) ? end : eol + 1;
+    }
+
+    if (nPoints < 0)
+        return ASF_INVALID_POINT_COUNT;
+
+    return landmarkCount == nPoints ? ASF_OK : ASF_MISSING_POINTS;
+}
+
+aam::AsfParseResult aam::parseAsfFile(const std::string& fileName, RowVectorX &coords, cv::Mat &contour, std::vector<char> &buffer) {
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (!file)
+        return ASF_FILE_ERROR;
+
+    // Read the whole file, growing the buffer only if it is too small.
+    size_t size = 0;
+    if (buffer.size() < 4096)
+        buffer.resize(4096);
+    for (;;) {
+        size += fread(buffer.data() + size, 1, buffer.size() - size, file);
+        if (size < buffer.size())
+            break;
+        buffer.resize(buffer.size() * 2);
+    }
+
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed)
+        return ASF_FILE_ERROR;
+
+    return parseAsf(buffer.data(), buffer.data() + size, coords, contour);
+}
+
+namespace {
+
+    /** Read the size of a JPEG image from its frame header without decoding it */
+    bool readJpegSize(const std::string& fileName, int& width, int& height) {
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file.is_open() || file.get() != 0xFF || file.get() != 0xD8) {
+            return false;
+        }
+
+        while (file) {
+            int c = file.get();
+            if (c != 0xFF) {
+                return false;
+            }
+
+            // markers may be preceded by fill bytes
+            int marker = file.get();
+            while (marker == 0xFF) {
+                marker = file.get();
+            }
+
+            // markers without segment
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD9)) {
+                continue;
+            }
+
+            int length = (file.get() << 8);
+            length |= file.get();
+            if (!file || length < 2) {
+                return false;
+            }
+
+            // start of frame, except for DHT, JPG and DAC
+            if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                file.get(); // precision
+                height = (file.get() << 8);
+                height |= file.get();
+                width = (file.get() << 8);
+                width |= file.get();
+                return (bool)file && width > 0 && height > 0;
+            }
+
+            file.seekg(length - 2, std::ios::cur);
+        }
 
-    if (!file.is_open()) {
         return false;
     }
+}
+
+/** Example of an ASF training set */
+struct AsfExample {
+    int majorIndex;
+    int minorIndex;
+    std::string baseName;
+
+    /** region of the image kept, empty to keep the full image */
+    cv::Rect crop;
+
+    /** size the kept region is scaled to, empty to keep its size */
+    cv::Size size;
+};
 
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.size() > 0) {
-            if (line[0] != '#') {
-                if (line.find(".jpg") != std::string::npos) {
-                    // ignored: file name of jpg image
-                }
-                else if (line.size() < 10) {
-                    int nbPoints = atol(line.c_str());
-                    coords.resize(1, nbPoints * 2);
-                    contours = cv::Mat(nbPoints, 3, CV_32SC1);
-                }
-                else {
-                    std::stringstream stream(line);
-                    std::string path;
-                    std::string type;
-                    std::string xStr;
-                    std::string yStr;
-                    std::string pointIdStr;
-                    std::string conn1Str;
-                    std::string conn2Str;
-                    stream >> path;
-                    stream >> type;
-                    stream >> xStr;
-                    stream >> yStr;
-                    stream >> pointIdStr;
-                    stream >> conn1Str;
-                    stream >> conn2Str;
-
-                    aam::Scalar x = (aam::Scalar)atof(xStr.c_str());
-                    aam::Scalar y = (aam::Scalar)atof(yStr.c_str());
-                    
-                    int id = atoi(pointIdStr.c_str());
-                    int c1 = atoi(conn1Str.c_str());
-                    int c2 = atoi(conn2Str.c_str());
-
-                    coords(0, landmarkCount * 2 + 0) = x;
-                    coords(0, landmarkCount * 2 + 1) = y;
-
-                    contours.at<int>(landmarkCount, 0) = id;
-                    contours.at<int>(landmarkCount, 1) = c1;
-                    contours.at<int>(landmarkCount, 2) = c2;
-
-                    landmarkCount++;
-                }
+struct aam::AsfTrainingSetLoader::Impl {
+    std::string directory;
+    int firstNExamplesToLoad;
+    bool color;
+    int nThreads;
+    int queueCapacity;
+    int cropMargin;
+    Scalar targetResolution;
+
+    /** examples in order */
+    std::vector<AsfExample> examples;
+
+    /** decoded images, indexed by example modulo queue capacity */
+    std::vector<cv::Mat> slots;
+    std::vector<bool> filled;
+
+    /** next example to decode */
+    int nextToDecode;
+
+    /** next example to hand out */
+    int nextToConsume;
+
+    /** first example whose image could not be loaded, -1 if none */
+    int failedExample;
+
+    bool stop;
+
+    std::mutex mutex;
+    std::condition_variable decoded;
+    std::condition_variable consumed;
+    std::vector<std::thread> workers;
+
+    void decode() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stop && nextToDecode < (int)examples.size()) {
+            const int i = nextToDecode++;
+
+            // wait for a free slot
+            consumed.wait(lock, [this, i] { return stop || i < nextToConsume + queueCapacity; });
+            if (stop) {
+                break;
+            }
+
+            lock.unlock();
+            std::string fileName = examples[i].baseName + ".jpg";
+            cv::Mat image;
+            {
+                AAM_SCOPED_TIMER(LOAD_DECODE);
+                AAM_COUNT(LOAD_DECODE, 1);
+                image = cv::imread(fileName, color ? 1 : 0);
+                prepareImage(examples[i], image);
             }
+            lock.lock();
+
+            slots[i % queueCapacity] = image;
+            filled[i % queueCapacity] = true;
+            decoded.notify_all();
         }
     }
-    return true;
+
+    /** Crop and scale a decoded image. Cropped pixels are copied, so the full image is released. */
+    static void prepareImage(const AsfExample& e, cv::Mat& image) {
+        if (image.empty()) {
+            return;
+        }
+
+        if (e.crop.area() > 0) {
+            image = image(e.crop & cv::Rect(0, 0, image.cols, image.rows)).clone();
+        }
+
+        if (e.size.area() > 0 && e.size != image.size()) {
+            cv::Mat scaled;
+            cv::resize(image, scaled, e.size, 0, 0, cv::INTER_AREA);
+            image = scaled;
+        }
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        consumed.notify_all();
+        decoded.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i) {
+            workers[i].join();
+        }
+        workers.clear();
+    }
+};
+
+aam::AsfTrainingSetLoader::AsfTrainingSetLoader(const std::string& directory, int firstNExamplesToLoad, bool color, int nThreads, int queueCapacity)
+    : _impl(new Impl())
+{
+    _impl->directory = directory;
+    _impl->firstNExamplesToLoad = firstNExamplesToLoad;
+    _impl->color = color;
+    _impl->nThreads = nThreads > 0 ? nThreads : std::max(1, (int)std::thread::hardware_concurrency());
+    _impl->queueCapacity = std::max(queueCapacity, 1);
+    _impl->failedExample = -1;
+    _impl->cropMargin = -1;
+    _impl->targetResolution = 0;
+    _impl->nextToDecode = 0;
+    _impl->nextToConsume = 0;
+    _impl->stop = false;
 }
 
-bool loadTrainingExample(const std::string& directory, int majorIndex, int minorIndex, const std::string& sex, cv::Mat& image, aam::RowVectorX& shape, cv::Mat& contour) {
-    char *name = new char[directory.size() + 100];
-#ifdef _WIN32
-    sprintf_s(name, directory.size() + 100, "%s/%02d-%d%s", directory.c_str(), majorIndex, minorIndex, sex.c_str());
-#else
-    sprintf(name, "%s/%02d-%d%s", directory.c_str(), majorIndex, minorIndex, sex.c_str());
-#endif
-    std::string fileNameImg = std::string(name) + ".jpg";
-    std::string fileNamePts = std::string(name) + ".asf";
-    
-    image = cv::imread(fileNameImg, 0);
-    std::cout << "loading " << fileNameImg << ", " << fileNamePts << std::endl;
-    
-    delete[] name;
+aam::AsfTrainingSetLoader::~AsfTrainingSetLoader() {
+    _impl->shutdown();
+}
 
-    return parseAsfFile(fileNamePts, shape, contour);
+void aam::AsfTrainingSetLoader::setCropMargin(int margin) {
+    _impl->cropMargin = margin;
 }
 
-bool aam::loadAsfTrainingSet(const std::string& directory, aam::TrainingSet& trainingSet, int firstNExamplesToLoad) {
+void aam::AsfTrainingSetLoader::setTargetResolution(aam::Scalar pixels) {
+    _impl->targetResolution = pixels;
+}
 
-    trainingSet.images.clear();
+int aam::AsfTrainingSetLoader::size() const {
+    return (int)_impl->examples.size();
+}
 
-    std::vector<aam::RowVectorX> shapeVecs;
+bool aam::AsfTrainingSetLoader::open(aam::TrainingSet& trainingSet) {
+    _impl->shutdown();
+
+    // enumerate examples once, a male and a female example of the same index are not expected
+    std::vector<cv::String> files;
+    cv::glob(_impl->directory + "/*.asf", files, false);
 
+    std::vector<AsfExample> &examples = _impl->examples;
+    examples.clear();
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string fileName = files[i];
+        size_t slash = fileName.find_last_of("/\\");
+        std::string name = fileName.substr(slash == std::string::npos ? 0 : slash + 1);
+
+        AsfExample e;
+        char sex = 0;
+        if (sscanf(name.c_str(), "%d-%d%c", &e.majorIndex, &e.minorIndex, &sex) == 3 && (sex == 'm' || sex == 'f')) {
+            e.baseName = fileName.substr(0, fileName.size() - 4);
+            examples.push_back(e);
+        }
+    }
+
+    std::stable_sort(examples.begin(), examples.end(), [](const AsfExample& a, const AsfExample& b) {
+        return a.majorIndex < b.majorIndex || (a.majorIndex == b.majorIndex && a.minorIndex < b.minorIndex);
+    });
+
+    if (_impl->firstNExamplesToLoad > 0 && (int)examples.size() > _impl->firstNExamplesToLoad) {
+        examples.resize(_impl->firstNExamplesToLoad);
+    }
+
+    // Parse landmarks, coordinates are given relative to the image size.
+    std::vector<aam::RowVectorX> shapeVecs;
+    std::vector<char> buffer;
     cv::Mat contour;
-    
-    bool ok = true;
-    int i = 1;
-    int counter = 0;
-    do {
-        bool subIdOK = true;
-        int j = 1;
-        do {
-            cv::Mat image;
-            aam::RowVectorX shape;
-            if (!loadTrainingExample(directory, i, j, "m", image, shape, contour)) {
-                loadTrainingExample(directory, i, j, "f", image, shape, contour);
+    for (size_t i = 0; i < examples.size(); ++i) {
+        aam::RowVectorX shape;
+        std::string fileNameImg = examples[i].baseName + ".jpg";
+        std::string fileNamePts = examples[i].baseName + ".asf";
+        {
+            AAM_SCOPED_TIMER(LOAD_PARSE);
+            AAM_COUNT(LOAD_PARSE, 1);
+            if (aam::parseAsfFile(fileNamePts, shape, contour, buffer) != aam::ASF_OK) {
+                return false;
             }
+        }
 
-            if (shape.cols() > 0) {
-                shapeVecs.push_back(shape);
-                trainingSet.images.push_back(image);
-                j++;
-                counter++;
-            }
+        int width = 0, height = 0;
+        if (!readJpegSize(fileNameImg, width, height)) {
+            cv::Mat image = cv::imread(fileNameImg, 0);
+            width = image.cols;
+            height = image.rows;
+        }
 
-            else {
-                subIdOK = false;
-            }
+        auto points = aam::toSeparatedView<Scalar>(shape);
+        points.col(0) *= (aam::Scalar)width;
+        points.col(1) *= (aam::Scalar)height;
+
+        // Keep only the bounding box of the shape plus margin, shape coordinates are made relative to it.
+        cv::Rect region(0, 0, width, height);
+        if (_impl->cropMargin >= 0) {
+            RowVector2 minC = points.colwise().minCoeff();
+            RowVector2 maxC = points.colwise().maxCoeff();
+            region = cv::Rect(
+                cv::Point((int)std::floor(minC.x()) - _impl->cropMargin, (int)std::floor(minC.y()) - _impl->cropMargin),
+                cv::Point((int)std::ceil(maxC.x()) + _impl->cropMargin + 1, (int)std::ceil(maxC.y()) + _impl->cropMargin + 1));
+            region &= cv::Rect(0, 0, width, height);
+
+            examples[i].crop = region;
+            points.col(0).array() -= (aam::Scalar)region.x;
+            points.col(1).array() -= (aam::Scalar)region.y;
+        }
+
+        // Downscale such that the larger side of the shape spans at most the target resolution.
+        if (_impl->targetResolution > 0 && region.area() > 0) {
+            RowVector2 dia = points.colwise().maxCoeff() - points.colwise().minCoeff();
+            aam::Scalar scaling = _impl->targetResolution / dia.maxCoeff();
+            if (scaling < 1) {
+                cv::Size size(
+                    std::max(1, (int)std::floor(region.width * scaling + aam::Scalar(0.5))),
+                    std::max(1, (int)std::floor(region.height * scaling + aam::Scalar(0.5))));
 
-            if ((firstNExamplesToLoad > 0) && (counter >= firstNExamplesToLoad)) {
-                ok = false;
+                // pixel edges of the region map onto pixel edges of the scaled image
+                examples[i].size = size;
+                points.col(0) *= (aam::Scalar)size.width / region.width;
+                points.col(1) *= (aam::Scalar)size.height / region.height;
             }
-        } while (ok && subIdOK);
-        if (j == 1) {
-            ok = false;
         }
-        i++;
-    } while (ok);
+
+        shapeVecs.push_back(shape);
+    }
+
+    if (shapeVecs.empty()) {
+        return false;
+    }
 
     // assemble the complete shape matrix from all training shapes that are given as row vectors
+    trainingSet.images.clear();
     trainingSet.shapes.resize(shapeVecs.size(), shapeVecs[0].cols());
-        
     for (size_t i = 0; i < shapeVecs.size(); ++i) {
-        aam::toSeparatedView<Scalar>(shapeVecs[i]).col(0) *= (aam::Scalar)trainingSet.images[i].cols;
-        aam::toSeparatedView<Scalar>(shapeVecs[i]).col(1) *= (aam::Scalar)trainingSet.images[i].rows;
         trainingSet.shapes.row(i) = shapeVecs[i];
     }
     trainingSet.contour = contour;
 
-    return ok;
+    // start decoding
+    _impl->slots.assign(_impl->queueCapacity, cv::Mat());
+    _impl->filled.assign(_impl->queueCapacity, false);
+    _impl->nextToDecode = 0;
+    _impl->nextToConsume = 0;
+    _impl->stop = false;
+    for (int i = 0; i < std::min(_impl->nThreads, (int)examples.size()); ++i) {
+        _impl->workers.push_back(std::thread(&Impl::decode, _impl.get()));
+    }
+
+    return true;
+}
+
+bool aam::AsfTrainingSetLoader::next(cv::Mat& image) {
+    std::unique_lock<std::mutex> lock(_impl->mutex);
+
+    const int i = _impl->nextToConsume;
+    if (i >= (int)_impl->examples.size() || _impl->workers.empty() || _impl->failedExample >= 0) {
+        return false;
+    }
+
+    const int slot = i % _impl->queueCapacity;
+    _impl->decoded.wait(lock, [this, slot] { return _impl->filled[slot]; });
+
+    image = _impl->slots[slot];
+    _impl->slots[slot] = cv::Mat();
+    _impl->filled[slot] = false;
+    _impl->nextToConsume++;
+
+    // Images that could not be read or decoded end the sequence.
+    if (image.empty()) {
+        _impl->failedExample = i;
+    }
+
+    lock.unlock();
+    _impl->consumed.notify_all();
+
+    return !image.empty();
+}
+
+bool aam::AsfTrainingSetLoader::failed() const {
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    return _impl->failedExample >= 0;
+}
+
+int aam::AsfTrainingSetLoader::failedExample() const {
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    return _impl->failedExample;
+}
+
+bool aam::loadAsfTrainingSet(const std::string& directory, aam::TrainingSet& trainingSet, int firstNExamplesToLoad, bool color) {
+    aam::AsfTrainingSetLoader loader(directory, firstNExamplesToLoad, color);
+    if (!loader.open(trainingSet)) {
+        return false;
+    }
+
+    cv::Mat image;
+    while (loader.next(image)) {
+        trainingSet.images.push_back(image);
+    }
+
+    return !loader.failed();
+}
+
+bool aam::saveTrainingSetCache(const std::string& path, const aam::TrainingSet& trainingSet) {
+    flatbuffers::FlatBufferBuilder fbb;
+    aam::io::FinishTrainingSetBuffer(fbb, aam::io::toFlatbuffers(fbb, trainingSet));
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == 0)
+        return false;
+
+    size_t written = fwrite(fbb.GetBufferPointer(), 1, fbb.GetSize(), f);
+
+    fclose(f);
+
+    return written == fbb.GetSize();
+}
+
+namespace {
+
+    /** Map a file copy-on-write into memory. Returns the mapping, which is unmapped when released, 
+        or an empty pointer on failure. */
+    std::shared_ptr<const void> mapFile(const std::string& path, size_t &size) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return std::shared_ptr<const void>();
+
+        LARGE_INTEGER fsize;
+        HANDLE mapping = NULL;
+        if (GetFileSizeEx(file, &fsize) && fsize.QuadPart > 0) {
+            mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        }
+        CloseHandle(file);
+        if (mapping == NULL)
+            return std::shared_ptr<const void>();
+
+        void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        CloseHandle(mapping);
+        if (data == NULL)
+            return std::shared_ptr<const void>();
+
+        size = (size_t)fsize.QuadPart;
+        return std::shared_ptr<const void>(data, [](const void *p) { UnmapViewOfFile(p); });
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return std::shared_ptr<const void>();
+
+        struct stat st;
+        void *data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            data = mmap(0, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (data == MAP_FAILED)
+            return std::shared_ptr<const void>();
+
+        size_t len = (size_t)st.st_size;
+        size = len;
+        return std::shared_ptr<const void>(data, [len](const void *p) { munmap(const_cast<void*>(p), len); });
+#endif
+    }
+}
+
+bool aam::loadTrainingSetCache(const std::string& path, aam::TrainingSet& trainingSet) {
+    size_t size = 0;
+    std::shared_ptr<const void> storage = mapFile(path, size);
+    if (!storage)
+        return false;
+
+    const uint8_t *buffer = static_cast<const uint8_t*>(storage.get());
+
+    // Verification only walks the tables, pixel data is not touched.
+    flatbuffers::Verifier verifier(buffer, size);
+    if (size < 8 || !aam::io::TrainingSetBufferHasIdentifier(buffer) || !aam::io::VerifyTrainingSetBuffer(verifier))
+        return false;
+
+    // Verification does not check that sizes agree, so pixel data might lie outside of the mapping.
+    aam::TrainingSet loaded;
+    if (!aam::io::fromFlatbuffers(*aam::io::GetTrainingSet(buffer), loaded))
+        return false;
+
+    loaded.storage = storage;
+    std::swap(trainingSet, loaded);
+
+    return true;
 }
\ No newline at end of file
@@ -21,8 +21,10 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #include <aam/io/serialization.h>
 #include <aam/io/aam_generated.h>
 #include <aam/model.h>
+#include <aam/trainingset.h>
 #include <aam/traits.h>
 #include <iostream>
+#include <cstring>
 
 namespace aam {
     namespace io {
@@ -96,6 +98,7 @@ namespace aam {
             auto o7 = toFlatbuffers(fbb, m.appearanceModes);
             auto o8 = toFlatbuffers(fbb, m.appearanceModeWeights);
             auto o9 = toFlatbuffers(fbb, (const ::aam::MatrixX &)m.shapeTransformToTrainingData);
+            auto o10 = toFlatbuffers(fbb, m.appearanceMeanGradient);
             
             ActiveAppearanceModelBuilder aamb(fbb);
             aamb.add_shapeMean(o1);
@@ -107,6 +110,7 @@ namespace aam {
             aamb.add_appearanceModes(o7);
             aamb.add_appearanceModeWeights(o8);
             aamb.add_shapeTransformToTrainingData(o9);
+            aamb.add_appearanceMeanGradient(o10);
 
             return aamb.Finish();
         }
@@ -125,6 +129,108 @@ namespace aam {
             fromFlatbuffers(*m.appearanceMean(), am.appearanceMean);
             fromFlatbuffers(*m.appearanceModes(), am.appearanceModes);
             fromFlatbuffers(*m.appearanceModeWeights(), am.appearanceModeWeights);
+
+            // Not present in models saved by earlier versions.
+            if (m.appearanceMeanGradient())
+                fromFlatbuffers(*m.appearanceMeanGradient(), am.appearanceMeanGradient);
+            else
+                am.appearanceMeanGradient.resize(0, 2);
+        }
+
+        flatbuffers::Offset<::aam::io::Image> toFlatbuffers(flatbuffers::FlatBufferBuilder &fbb, const cv::Mat &m)
+        {
+            const size_t rowBytes = m.cols * m.elemSize();
+
+            // copy row by row, the image may not be continuous
+            uint8_t *data = 0;
+            flatbuffers::Offset<flatbuffers::Vector<uint8_t> > od = fbb.CreateUninitializedVector(m.rows * rowBytes, &data);
+            for (int r = 0; r < m.rows; ++r) {
+                memcpy(data + r * rowBytes, m.ptr(r), rowBytes);
+            }
+
+            ImageBuilder ib(fbb);
+            ib.add_rows(m.rows);
+            ib.add_cols(m.cols);
+            ib.add_type(m.type());
+            ib.add_data(od);
+
+            return ib.Finish();
+        }
+
+        flatbuffers::Offset<::aam::io::TrainingSet> toFlatbuffers(flatbuffers::FlatBufferBuilder &fbb, const ::aam::TrainingSet &t)
+        {
+            std::vector< flatbuffers::Offset<::aam::io::Image> > images;
+            for (size_t i = 0; i < t.images.size(); ++i) {
+                images.push_back(toFlatbuffers(fbb, t.images[i]));
+            }
+
+            auto o1 = toFlatbuffers(fbb, t.shapes);
+            auto o2 = toFlatbuffers(fbb, t.triangles);
+            auto o3 = toFlatbuffers(fbb, t.contour);
+            auto o4 = fbb.CreateVector(images);
+
+            TrainingSetBuilder tb(fbb);
+            tb.add_shapes(o1);
+            tb.add_triangles(o2);
+            tb.add_contour(o3);
+            tb.add_images(o4);
+
+            return tb.Finish();
+        }
+
+        /** True if the matrix is present and holds exactly rows times cols elements. Verification 
+            of a buffer only checks that fields lie within the buffer, not that they agree. */
+        template<class M>
+        bool hasConsistentSize(const M *mfb)
+        {
+            return mfb != 0 && mfb->rows() >= 0 && mfb->cols() >= 0 && mfb->data() != 0 &&
+                (int64_t)mfb->rows() * mfb->cols() == (int64_t)mfb->data()->size();
+        }
+
+        bool fromFlatbuffers(const ::aam::io::Image &mfb, cv::Mat &m)
+        {
+            if (mfb.rows() < 0 || mfb.cols() < 0 || mfb.type() != CV_MAT_TYPE(mfb.type()) || CV_MAT_DEPTH(mfb.type()) > CV_64F)
+                return false;
+
+            if (mfb.rows() == 0 || mfb.cols() == 0) {
+                m = cv::Mat();
+                return true;
+            }
+
+            const int64_t bytes = (int64_t)mfb.rows() * mfb.cols() * CV_ELEM_SIZE(mfb.type());
+            if (mfb.data() == 0 || (int64_t)mfb.data()->size() != bytes)
+                return false;
+
+            m = cv::Mat(mfb.rows(), mfb.cols(), mfb.type(), (void*)mfb.data()->data());
+            return true;
+        }
+
+        bool fromFlatbuffers(const ::aam::io::TrainingSet &tfb, ::aam::TrainingSet &t)
+        {
+            if (!hasConsistentSize(tfb.shapes()) || !hasConsistentSize(tfb.triangles()) || tfb.triangles()->rows() != 1 || tfb.images() == 0)
+                return false;
+
+            // one image per shape
+            if ((int64_t)tfb.shapes()->rows() != (int64_t)tfb.images()->size())
+                return false;
+
+            fromFlatbuffers(*tfb.shapes(), t.shapes);
+            fromFlatbuffers(*tfb.triangles(), t.triangles);
+
+            if (tfb.contour()) {
+                if (!fromFlatbuffers(*tfb.contour(), t.contour))
+                    return false;
+            } else {
+                t.contour = cv::Mat();
+            }
+
+            t.images.resize(tfb.images()->size());
+            for (flatbuffers::uoffset_t i = 0; i < tfb.images()->size(); ++i) {
+                if (!fromFlatbuffers(*tfb.images()->Get(i), t.images[i]))
+                    return false;
+            }
+
+            return true;
         }
 
     }
@@ -23,7 +23,9 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #include <aam/fwd.h>
 #include <aam/transform.h>
 #include <aam/map.h>
+#include <aam/views.h>
 #include <aam/rasterization.h>
+#include <aam/instrumentation.h>
 #include <iostream>
 
 #include <imagealign/imagealign.h>
@@ -34,6 +36,8 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <stdlib.h>
+#include <algorithm>
+#include <limits>
 
 namespace ia = imagealign;
 
@@ -47,54 +51,41 @@ namespace aam {
         return currentWarp;
     }
 
-    void setInvalidPixelsToZero(cv::Mat& image, const cv::Mat& mask) {
-        for (int i = 1; i < image.rows-1; i++) {
-            for (int j = 1; j < image.cols-1; j++) {
-                if (mask.at<unsigned char>(i, j) == 0) {
-                    image.at<float>(i, j) = 0;
-                    image.at<float>(i-1, j) = 0;
-                    image.at<float>(i, j-1) = 0;
-                    image.at<float>(i+1, j) = 0;
-                    image.at<float>(i, j+1) = 0;
-
-                    image.at<float>(i-1, j-1) = 0;
-                    image.at<float>(i+1, j-1) = 0;
-                    image.at<float>(i-1, j+1) = 0;
-                    image.at<float>(i+1, j+1) = 0;
-                }
-            }
+    /** Read the gray value at (x, y) given in coordinates of the image the bound region stems from.
+        Positions outside of the bound region are clamped to its border. */
+    inline Scalar sampleImage(const cv::Mat& image, const cv::Point& offset, Scalar x, Scalar y) {
+        int ix = std::min(std::max((int)x - offset.x, 0), image.cols - 1);
+        int iy = std::min(std::max((int)y - offset.y, 0), image.rows - 1);
+        return image.at<unsigned char>(iy, ix);
+    }
+
+    /** Make sure the template gradient is available. Models saved by earlier versions lack it, 
+        compute it once on the mean shape in training data coordinates. */
+    void ensureGradientOfMeanAppearance(ActiveAppearanceModel& model) {
+        if (model.appearanceMeanGradient.rows() != model.appearanceMean.cols()) {
+            RowVectorX s0 = transformShape(model.shapeTransformToTrainingData, model.shapeMean);
+            computeShapeImageGradient(
+                s0, 
+                model.triangleIndices, 
+                model.barycentricSamplePositions, 
+                model.appearanceMean, 
+                model.appearanceMeanGradient);
         }
     }
 
-    void calcGradientOfMeanAppearance(const cv::Mat& image, ActiveAppearanceModel& model, std::vector<aam::MatrixX>& grad) {
-        
-        cv::Mat meanTextureImage = cv::Mat(image.rows, image.cols, CV_8U);
-        meanTextureImage = cv::Scalar(0);
-        model.renderAppearanceInstanceToImage(meanTextureImage, model.shapeTransformToTrainingData, MatrixX::Zero(1, model.shapeModeWeights.cols()), MatrixX::Zero(1, model.appearanceModeWeights.cols()), false);
-        cv::Mat gradX;
-        cv::Mat gradY;
-        cv::Sobel(meanTextureImage, gradX, CV_32F, 1, 0, 3);
-        cv::Sobel(meanTextureImage, gradY, CV_32F, 0, 1, 3);
-        
-        setInvalidPixelsToZero(gradX, meanTextureImage);
-        setInvalidPixelsToZero(gradY, meanTextureImage);
-        cv::imshow("gradX", gradX * (1.0/512) + 0.5);
-        cv::imshow("gradY", gradY * (1.0/512) + 0.5);
+    void calcGradientOfMeanAppearance(ActiveAppearanceModel& model, std::vector<aam::MatrixX>& grad) {
 
-        std::vector<aam::RowVector2> cartesianCoords;
-        model.getCartesianPixelCoordinates(model.shapeTransformToTrainingData, MatrixX::Zero(1, model.shapeModeWeights.cols()), cartesianCoords);
+        ensureGradientOfMeanAppearance(model);
+
+        // the template gradient is given with respect to training data coordinates, 
+        // Jacobians are evaluated in normalized shape coordinates.
+        MatrixX g = model.appearanceMeanGradient * model.shapeTransformToTrainingData.topRows<2>().transpose();
 
         grad.clear();
-        for (size_t i = 0; i < cartesianCoords.size(); i++) {
-            aam::MatrixX g(1, 2);
-            int x = (int)cartesianCoords[i](0, 0);
-            int y = (int)cartesianCoords[i](0, 1);
-            g(0, 0) = gradX.at<float>(y, x);
-            g(0, 1) = gradY.at<float>(y, x);
-            grad.push_back(g);
+        grad.reserve(g.rows());
+        for (MatrixX::Index i = 0; i < g.rows(); i++) {
+            grad.push_back(g.row(i));
         }
-        
-        //cv::waitKey(0);
     }
 
     void evaluateJacobianPerPixel(ActiveAppearanceModel& model, std::vector<MatrixX>& jacobians) {  
@@ -147,18 +138,53 @@ namespace aam {
         }
     }
 
-    void calcInvHessian(const std::vector<MatrixX>& sd, MatrixX& invHessian) {
-        invHessian = MatrixX::Zero(4, 4);
+    /** Accumulate the Hessian in precision T */
+    template<class T>
+    void calcHessian(const std::vector<MatrixX>& sd, MatrixX& hessian) {
+        typename AamMatrixTraits<T>::MatrixType h = AamMatrixTraits<T>::MatrixType::Zero(4, 4);
 
         for (size_t i = 0; i < sd.size(); i++) {
-            invHessian += sd[i].adjoint() * sd[i];
+            typename AamMatrixTraits<T>::MatrixType sdi = sd[i].template cast<T>();
+            h.noalias() += sdi.adjoint() * sdi;
         }
 
-        invHessian = invHessian.inverse();
+        hessian = h.template cast<Scalar>();
+    }
+
+    /** Initial Levenberg-Marquardt damping relative to the diagonal of the Hessian */
+    const Scalar initialDamping = Scalar(1e-3);
+
+    /** Bounds of the Levenberg-Marquardt damping */
+    const Scalar minDamping = Scalar(1e-7);
+    const Scalar maxDamping = Scalar(1e7);
+
+    /** Number of damped updates tried per step before giving up */
+    const int maxDampingTrials = 8;
+
+    /** Number of reweighting iterations refining robust appearance parameters per evaluation */
+    const int robustAppearanceIterations = 2;
+
+    /** Solve the damped normal equations (H + damping * diag(H)) delta = b */
+    template<class M>
+    M solveDamped(const M& hessian, const M& b, Scalar damping) {
+        M damped = hessian;
+        damped.diagonal() *= 1 + damping;
+        return damped.ldlt().solve(b);
+    }
+
+    /** True if the decomposed symmetric positive semi-definite matrix is numerically of full rank */
+    inline bool hasFullRank(const Eigen::LDLT<TrainingMatrixX>& ldlt) {
+        if (ldlt.info() != Eigen::Success)
+            return false;
+        if (ldlt.rows() == 0)
+            return true;
+        
+        const TrainingScalar tolerance = std::sqrt(std::numeric_limits<TrainingScalar>::epsilon());
+        return ldlt.vectorD().minCoeff() > tolerance * ldlt.vectorD().maxCoeff();
     }
 
     // convert parameter representation to affine transformation
-    Affine2 paramsToWarp(const Eigen::Ref<MatrixX> params) {
+    Affine2 paramsToWarp(const Eigen::Ref<const MatrixX>& params) {
         Affine2 retVal;
         
         // note: b and -b are swapped as we are doing multiplication from left side (i.e. row vectors)
@@ -172,13 +198,40 @@ namespace aam {
         return retVal;
     }
 
+    /** Compose the warp with the inverse of the warp given by the first four parameters of the update */
+    Affine2 composeInverseUpdate(const Affine2& warp, const Eigen::Ref<const MatrixX>& delta) {
+        typedef AamMatrixTraits<Scalar, 3, 3>::MatrixType Matrix3;
+
+        // get the current warp as 3x3 matrix
+        Matrix3 currentWarp3x3;
+        currentWarp3x3.block<3, 2>(0, 0) = warp;
+        currentWarp3x3(0, 2) = 0;
+        currentWarp3x3(1, 2) = 0;
+        currentWarp3x3(2, 2) = 1;
+
+        // get the warp update as 3x3 matrix (derive from delta)
+        Matrix3 updateWarp3x3;
+        updateWarp3x3.block<3, 2>(0, 0) = paramsToWarp(delta.topRows(4));
+        updateWarp3x3(0, 2) = 0;
+        updateWarp3x3(1, 2) = 0;
+        updateWarp3x3(2, 2) = 1;
+
+        // switch sequence in multiplication of warp matrices compared to AAMs revisited paper
+        // (as we are using row vectors, so vectors would be multiplied from left side)
+        return (updateWarp3x3.inverse() * currentWarp3x3).block<3, 2>(0, 0);
+    }
+
     void Matcher::init(const cv::Mat& img, Scalar x, Scalar y, aam::RowVectorX& shapeParams, aam::RowVectorX& textureParams) {
 
-        image = img.clone();
+        // bind the image by reference, no copy
+        image = img;
+
+        // gray models only
+        eigen_assert(model.appearanceChannels() == 1);
 
         // calculate the gradient of the template (i.e. mean appearance image)
         // gradients are 1x2
-        calcGradientOfMeanAppearance(image, model, grad);
+        calcGradientOfMeanAppearance(model, grad);
 
         // evaluate the Jacobian at (x; 0)
         // jacobians are 2x4
@@ -188,9 +241,8 @@ namespace aam {
         // steepest descent images are 1x4
         elementWiseMult(grad, jacobians, steepestDecentImgs);
 
-        // compute the inverse Hessian matrix (eq. 23)
-        // inverse hessian is 4x4
-        calcInvHessian(steepestDecentImgs, invHessian);
+        // compute the Hessian matrix (eq. 23), 4x4
+        calcHessian<TrainingScalar>(steepestDecentImgs, hessian);
 
         // calculate cartesian sample positions of mean shape
         model.getCartesianPixelCoordinates(Affine2::Identity(), shapeParams, coords);
@@ -199,6 +251,18 @@ namespace aam {
         currentWarp = model.shapeTransformToTrainingData;
         currentWarp(2, 0) = x;
         currentWarp(2, 1) = y;
+
+        damping = initialDamping;
+    }
+
+    Scalar Matcher::evaluateError(const Affine2& warp) {
+        Scalar sum = 0;
+        for (size_t i = 0; i < coords.size(); i++) {
+            RowVector2 warpedPt = transformShape(warp, coords[i]);
+            aam::Scalar diff = sampleImage(image, cv::Point(0, 0), warpedPt(0, 0), warpedPt(0, 1)) - model.appearanceMean(i);
+            sum += diff * diff;
+        }
+        return sum;
     }
 
     void Matcher::step() {
@@ -218,7 +282,7 @@ namespace aam {
 
             // get gray values from model and image
             aam::Scalar gModel = model.appearanceMean(i);
-            aam::Scalar gImg = image.at<unsigned char>((int)warpedPt(0, 1), (int)warpedPt(0, 0));
+            aam::Scalar gImg = sampleImage(image, cv::Point(0, 0), warpedPt(0, 0), warpedPt(0, 1));
 
             // calculate difference of model and image
             aam::Scalar diff = gImg - gModel;
@@ -228,306 +292,638 @@ namespace aam {
         }
 
         // (step 8 in figure 7, AAMs revisited)
-        // pre-multiply the inverse hessian (see equation 22 in Matthews et. al, "Active Appearance Models Revisited", IJCV, 2004)
-        deltaParam = invHessian * deltaParam * aam::Scalar(0.1);  // update with weight 0.1, TODO: remove this artificial weighting of the update
-        //deltaParam = invHessian * deltaParam;
-
-        // get the current warp as 3x3 matrix
-        MatrixX currentWarp3x3(3, 3);
-        currentWarp3x3.block<3, 2>(0, 0) = currentWarp;
-        currentWarp3x3(0, 2) = 0;
-        currentWarp3x3(1, 2) = 0;
-        currentWarp3x3(2, 2) = 1;
-
-        // get the warp update as 3x3 matrix (derive from deltaParam)
-        MatrixX updateWarp3x3(3, 3);
-        updateWarp3x3.block<3, 2>(0, 0) = paramsToWarp(deltaParam);
-        updateWarp3x3(0, 2) = 0;
-        updateWarp3x3(1, 2) = 0;
-        updateWarp3x3(2, 2) = 1;
-
-        // use this to exclude rotation and scaling from update
-        //updateWarp3x3(0, 0) = 1;
-        //updateWarp3x3(1, 1) = 1;
-        //updateWarp3x3(0, 1) = 0;
-        //updateWarp3x3(1, 0) = 0;
+        // solve the damped normal equations (see equation 22 in Matthews et. al, "Active Appearance Models Revisited", IJCV, 2004)
+        // and compose the warp (step 9), increasing the damping until the error decreases.
+        MatrixX b = deltaParam;
+        for (int trial = 0; trial < maxDampingTrials; trial++) {
+            deltaParam = solveDamped(hessian, b, damping);
+
+            Affine2 warp = composeInverseUpdate(currentWarp, deltaParam);
+            if (evaluateError(warp) < rms) {
+                currentWarp = warp;
+                damping = std::max(damping * Scalar(0.1), minDamping);
+                break;
+            }
 
-        // update the current warp (step 9 in figure 7, AAMs revisited)
-        // switch sequence in multiplication of warp matrices compared to AAMs revisited paper
-        // (as we are using row vectors, so vectors would be multiplied from left side)
-        currentWarp = (updateWarp3x3.inverse() * currentWarp3x3).block<3, 2>(0, 0);
+            damping = std::min(damping * Scalar(10), maxDamping);
+        }
 
         // calculate the root mean squared error (should be minimized by this optimization procedure)
         rms = sqrt(rms / coords.size());
+#ifdef AAM_MATCHER_VERBOSE
         std::cout << "Root Mean Squared Error = " << rms << std::endl;
 
-        std::cout << std::endl << "delta Params 3x3: " << std::endl << updateWarp3x3 << std::endl;
-
         std::cout << std::endl << "delta Params (4x1): " << std::endl << deltaParam << std::endl;
 
         std::cout << std::endl << "current warp: " << std::endl << currentWarp << std::endl;
+#endif
     }
 
 
 
-	Matcher2::Matcher2(const aam::ActiveAppearanceModel& model) {
-        this->model = model;
+	Matcher2::Matcher2(const aam::ActiveAppearanceModel& model, Algorithm algorithm) 
+        : algorithm(algorithm), robustError(LEAST_SQUARES), robustScale(0), roiMargin(-1), currentError(0), damping(initialDamping)
+    {
+        // the model is shared with copies of this matcher, make sure the template gradient is 
+        // available before sharing.
+        std::shared_ptr<ActiveAppearanceModel> m = std::make_shared<ActiveAppearanceModel>(model);
+        ensureGradientOfMeanAppearance(*m);
+        this->model = m;
     }
 
     Affine2 Matcher2::getCurrentGlobalTransform() {
         return currentWarp;
     }
 
-    MatrixX Matcher2::getCurrentShapeParams() {
+    const RowVectorX& Matcher2::getCurrentShapeParams() const {
         return currentShapeParams;
     }
 
-    MatrixX Matcher2::getCurrentAppearanceParams() {
+    const RowVectorX& Matcher2::getCurrentAppearanceParams() const {
         return currentAppearanceParams;
     }
 
-    void evaluateJacobiansGlobalTransform(ActiveAppearanceModel& model, std::vector<MatrixX>& jacobians) {  
+    Scalar Matcher2::getCurrentError() {
+        return currentError;
+    }
 
-        jacobians.clear();
+    void Matcher2::setImage(const cv::Mat& img) {
+        image = img;
+        imageOffset = cv::Point(0, 0);
+        fullImage = cv::Mat();
+        roiMargin = -1;
+    }
 
-        MatrixX s = model.shapeMean;
+    void Matcher2::setImageROI(const cv::Mat& img, int margin) {
+        fullImage = img;
+        roiMargin = std::max(margin, 0);
 
-        for (int i = 0; i < model.barycentricSamplePositions.rows(); i++) {
+        // bounding box of the current shape instance in image coordinates
+        work.shape.resize(model->shapeMean.cols());
+        model->reconstructShape(currentShapeParams, work.shape);
+        transformShapeInPlace(currentWarp, work.shape);
 
-            // get triangle, vertices and shape
-            int triangleID = (int)model.barycentricSamplePositions(i, 0);
-            aam::Scalar alpha = model.barycentricSamplePositions(i, 1);
-            aam::Scalar beta = model.barycentricSamplePositions(i, 2);
-            int pt1idx = model.triangleIndices(0, triangleID * 3 + 0);
-            int pt2idx = model.triangleIndices(0, triangleID * 3 + 1);
-            int pt3idx = model.triangleIndices(0, triangleID * 3 + 2);
-            
-			Scalar a = 1 - alpha - beta;
-			Scalar b = alpha;
-			Scalar c = beta;
+        image = cv::Mat();
+        updateImageROI(work.shape);
+    }
 
-            // calculate x and y of the current pixel
-            aam::Scalar x = s(0, pt1idx * 2 + 0) * a + s(0, pt2idx * 2 + 0) * b + s(0, pt3idx * 2 + 0) * c;
-            aam::Scalar y = s(0, pt1idx * 2 + 1) * a + s(0, pt2idx * 2 + 1) * b + s(0, pt3idx * 2 + 1) * c;
-            
-            // calculate the Jacobian matrix
-            AamMatrixTraits<Scalar, 2, 4>::MatrixType jacobian;
-            jacobian(0, 0) = x;
-            jacobian(0, 1) = -y;
-            jacobian(0, 2) = 1;
-            jacobian(0, 3) = 0;
+    void Matcher2::updateImageROI(const RowVectorX& shape) {
 
-            jacobian(1, 0) = y;
-            jacobian(1, 1) = x;
-            jacobian(1, 2) = 0;
-            jacobian(1, 3) = 1;
+        // samples lie within the triangles of the shape instance. Bilinear interpolation reads 
+        // the pixels surrounding a sample position, which is shifted to pixel centers.
+        Scalar minX = shape(0), maxX = shape(0), minY = shape(1), maxY = shape(1);
+        for (RowVectorX::Index i = 2; i < shape.cols(); i += 2) {
+            minX = std::min(minX, shape(i));
+            maxX = std::max(maxX, shape(i));
+            minY = std::min(minY, shape(i + 1));
+            maxY = std::max(maxY, shape(i + 1));
+        }
 
-            // add the Jacobian for this pixel to the list
-            jacobians.push_back(jacobian);
+        const cv::Rect bounds(0, 0, fullImage.cols, fullImage.rows);
+        cv::Rect required(
+            cv::Point((int)std::floor(minX) - 1, (int)std::floor(minY) - 1),
+            cv::Point((int)std::ceil(maxX) + 2, (int)std::ceil(maxY) + 2));
+        required &= bounds;
+
+        if (required.area() == 0) {
+            // shape entirely outside of the image, samples are clamped to the border of the full image
+            image = fullImage;
+            imageOffset = cv::Point(0, 0);
+            return;
         }
+
+        const cv::Rect current(imageOffset, image.size());
+        if (!image.empty() && (required & current) == required) {
+            return;
+        }
+
+        cv::Rect roi(
+            cv::Point(required.x - roiMargin, required.y - roiMargin),
+            cv::Point(required.br().x + roiMargin, required.br().y + roiMargin));
+        roi &= bounds;
+
+        // header only, no pixels are copied
+        image = fullImage(roi);
+        imageOffset = roi.tl();
     }
 
-    void evaluateWarpJacobians(ActiveAppearanceModel& model, std::vector<MatrixX>& jacobians) {  
+    void Matcher2::setCurrentGlobalTransform(const Affine2& warp) {
+        currentWarp = warp;
+        damping = initialDamping;
+    }
 
-        jacobians.clear();
+    void Matcher2::setCurrentShapeParams(const RowVectorX& shapeParams) {
+        currentShapeParams = shapeParams;
+    }
 
-        MatrixX s = model.shapeMean;
+    void Matcher2::setCurrentAppearanceParams(const RowVectorX& appearanceParams) {
+        currentAppearanceParams = appearanceParams;
+    }
 
-        for (int i = 0; i < model.barycentricSamplePositions.rows(); i++) {
+    /** Compute the steepest descent images grad(A) d(N o W)/d(q; p) evaluated at (x; 0) for the 
+        given (N*C)x2 appearance gradient in training data coordinates. Each row corresponds to a sample 
+        position and channel, the first four columns to the global shape transform parameters q followed 
+        by one column per shape parameter p. The warp Jacobian is evaluated once per sample position 
+        and shared by its channels. Computed in TrainingScalar precision. */
+    void computeSteepestDescentImages(const ActiveAppearanceModel& model, const TrainingMatrixX& appearanceGradient, Eigen::Ref<TrainingMatrixX> sd) {
+
+        const int nSamples = (int)model.barycentricSamplePositions.rows();
+        const int nChannels = model.appearanceChannels();
+        const int nShapeParams = (int)model.shapeModes.rows();
+
+        // appearance gradient is given with respect to training data coordinates, Jacobians are 
+        // evaluated in normalized shape coordinates.
+        TrainingMatrixX grad = appearanceGradient * model.shapeTransformToTrainingData.topRows<2>().transpose().cast<TrainingScalar>();
+
+        const TrainingRowVectorX s = model.shapeMean.cast<TrainingScalar>();
+        const TrainingMatrixX modes = model.shapeModes.cast<TrainingScalar>();
+
+        eigen_assert(sd.rows() == nSamples * nChannels && sd.cols() == 4 + nShapeParams);
+
+        TrainingRowVectorX modeX(nShapeParams), modeY(nShapeParams);
+
+        for (int i = 0; i < nSamples; i++) {
 
             // get triangle, vertices and shape
             int triangleID = (int)model.barycentricSamplePositions(i, 0);
-            aam::Scalar alpha = model.barycentricSamplePositions(i, 1);
-            aam::Scalar beta = model.barycentricSamplePositions(i, 2);
+            TrainingScalar alpha = model.barycentricSamplePositions(i, 1);
+            TrainingScalar beta = model.barycentricSamplePositions(i, 2);
             int pt1idx = model.triangleIndices(0, triangleID * 3 + 0);
             int pt2idx = model.triangleIndices(0, triangleID * 3 + 1);
             int pt3idx = model.triangleIndices(0, triangleID * 3 + 2);
-            
-			Scalar a = 1 - alpha - beta;
-			Scalar b = alpha;
-			Scalar c = beta;
+
+            TrainingScalar a = 1 - alpha - beta;
+            TrainingScalar b = alpha;
+            TrainingScalar c = beta;
 
             // calculate x and y of the current pixel
-            aam::Scalar x = s(0, pt1idx * 2 + 0) * a + s(0, pt2idx * 2 + 0) * b + s(0, pt3idx * 2 + 0) * c;
-            aam::Scalar y = s(0, pt1idx * 2 + 1) * a + s(0, pt2idx * 2 + 1) * b + s(0, pt3idx * 2 + 1) * c;
-            
-			// calculate the Jacobian matrix
-            MatrixX jacobian = MatrixX::Zero(2, model.shapeModeWeights.cols());
+            TrainingScalar x = s(0, pt1idx * 2 + 0) * a + s(0, pt2idx * 2 + 0) * b + s(0, pt3idx * 2 + 0) * c;
+            TrainingScalar y = s(0, pt1idx * 2 + 1) * a + s(0, pt2idx * 2 + 1) * b + s(0, pt3idx * 2 + 1) * c;
 
-			for (int j = 0; j < model.shapeModeWeights.cols(); j++) {
-				jacobian(0, j) = a * model.shapeModes(j, pt1idx * 2 + 0) + b * model.shapeModes(j, pt2idx * 2 + 0) + c * model.shapeModes(j, pt3idx * 2 + 0);
-				jacobian(1, j) = a * model.shapeModes(j, pt1idx * 2 + 1) + b * model.shapeModes(j, pt2idx * 2 + 1) + c * model.shapeModes(j, pt3idx * 2 + 1);
-			}
+            // shape modes, Jacobian of the piecewise affine warp is the interpolated mode displacement
+            modeX.noalias() = (a * modes.col(pt1idx * 2 + 0) + b * modes.col(pt2idx * 2 + 0) + c * modes.col(pt3idx * 2 + 0)).transpose();
+            modeY.noalias() = (a * modes.col(pt1idx * 2 + 1) + b * modes.col(pt2idx * 2 + 1) + c * modes.col(pt3idx * 2 + 1)).transpose();
 
-            // add the Jacobian to the list
-            jacobians.push_back(jacobian);
+            for (int ch = 0; ch < nChannels; ch++) {
+                const int r = i * nChannels + ch;
+                TrainingScalar gx = grad(r, 0);
+                TrainingScalar gy = grad(r, 1);
+
+                // global shape transform, Jacobian is [x -y 1 0; y x 0 1]
+                sd(r, 0) = gx * x + gy * y;
+                sd(r, 1) = -gx * y + gy * x;
+                sd(r, 2) = gx;
+                sd(r, 3) = gy;
+
+                sd.row(r).tail(nShapeParams) = gx * modeX + gy * modeY;
+            }
         }
     }
 
-	void computeSteepestDescentImages(
-		ActiveAppearanceModel& model,
-		const std::vector<MatrixX>& grad,
-		std::vector<MatrixX>& trafoJacobians,
-		std::vector<MatrixX>& warpJacobians,
-		std::vector<MatrixX>& steepestDescentImgs) {
+    /** Project the steepest descent images out of the appearance subspace (eq. 63 and 64).
+        Since appearance modes are orthonormal this amounts to SD - A^T (A SD). */
+    void projectOutAppearanceVariation(const ActiveAppearanceModel& model, TrainingMatrixX& sd) {
+        TrainingMatrixX modes = model.appearanceModes.cast<TrainingScalar>();
+        TrainingMatrixX asd = modes * sd;
+        sd.noalias() -= modes.transpose() * asd;
+    }
 
-		MatrixX s = model.shapeMean;
+    /** Gather the given rows of a matrix */
+    MatrixX gatherRows(const MatrixX& m, const std::vector<int>& indices) {
+        MatrixX r(indices.size(), m.cols());
+        for (size_t i = 0; i < indices.size(); i++) {
+            r.row(i) = m.row(indices[i]);
+        }
+        return r;
+    }
 
-		steepestDescentImgs.clear();
+    /** Gather the given columns of a matrix */
+    MatrixX gatherCols(const MatrixX& m, const std::vector<int>& indices) {
+        MatrixX r(m.rows(), indices.size());
+        for (size_t i = 0; i < indices.size(); i++) {
+            r.col(i) = m.col(indices[i]);
+        }
+        return r;
+    }
 
-		// compute term 
-		//   grad(A0) * dN/dq_j  and 
-		//   grad(A0) * dW/dq_j
-		
-		for (int j = 0; j < 4 + model.shapeModeWeights.cols(); j++) {
-
-			MatrixX gradA0dNdj(model.barycentricSamplePositions.rows(), 1);
-
-			std::vector<MatrixX> jacobians; 
-            int paramIdx;
-			if (j < 4) {
-				jacobians = trafoJacobians;
-                paramIdx = j;
-			} else {
-				jacobians = warpJacobians;
-                paramIdx = j - 4;
-			}
+    /** Indices of the appearance entries of the given samples, channels are interleaved per sample */
+    std::vector<int> channelIndices(const std::vector<int>& samples, int nChannels) {
+        std::vector<int> r(samples.size() * nChannels);
+        for (size_t k = 0; k < samples.size(); k++) {
+            for (int c = 0; c < nChannels; c++) {
+                r[k * nChannels + c] = samples[k] * nChannels + c;
+            }
+        }
+        return r;
+    }
 
-			for (int i = 0; i < model.barycentricSamplePositions.rows(); i++) {
-				gradA0dNdj(i, 0) = grad[i](0, 0) * jacobians[i](0, paramIdx) + grad[i](0, 1) * jacobians[i](1, paramIdx);
-			}
+    /** Read the cn channel values at (x, y) given in pixel coordinates of the input image (pixel centers 
+        at integer positions) by bilinear interpolation from the bound region located at offset. Positions 
+        outside of the bound region are clamped to its border. Coordinates are not shifted by the offset 
+        before interpolation, so that weights are bitwise identical whichever region is bound. Interpolation 
+        weights and pixel addresses are computed once for all channels. */
+    template<int cn>
+    inline void sampleImageBilinear(const cv::Mat& image, const cv::Point& offset, Scalar x, Scalar y, Scalar *values) {
+        x = std::min(std::max(x, Scalar(offset.x)), Scalar(offset.x + image.cols - 1));
+        y = std::min(std::max(y, Scalar(offset.y)), Scalar(offset.y + image.rows - 1));
+
+        const int xi = (int)x;
+        const int yi = (int)y;
+        const Scalar fx = x - xi;
+        const Scalar fy = y - yi;
+
+        // addresses within the bound region
+        const int x0 = xi - offset.x;
+        const int y0 = yi - offset.y;
+        const int x1 = std::min(x0 + 1, image.cols - 1);
+        const int y1 = std::min(y0 + 1, image.rows - 1);
+
+        const unsigned char *p00 = image.ptr<unsigned char>(y0) + x0 * cn;
+        const unsigned char *p01 = image.ptr<unsigned char>(y0) + x1 * cn;
+        const unsigned char *p10 = image.ptr<unsigned char>(y1) + x0 * cn;
+        const unsigned char *p11 = image.ptr<unsigned char>(y1) + x1 * cn;
+        for (int c = 0; c < cn; c++) {
+            const Scalar top = p00[c] + fx * (Scalar(p01[c]) - p00[c]);
+            const Scalar bottom = p10[c] + fx * (Scalar(p11[c]) - p10[c]);
+            values[c] = top + fy * (bottom - top);
+        }
+    }
 
-			// inner sum of equations 63 and 64 (sum over all x of Ai(x) * grad A0 dN/dqj)
-			MatrixX innerSum = MatrixX::Zero(model.appearanceModeWeights.cols(), 1);
-			for (int i = 0; i < model.appearanceModeWeights.cols(); i++) {
-				innerSum(i, 0) = model.appearanceModes.row(i) * gradA0dNdj.col(0);
-			}
-			
-			MatrixX steepestDescentImg(model.barycentricSamplePositions.rows(), 1);
-			MatrixX subtractedPart = MatrixX::Zero(model.barycentricSamplePositions.rows(), 1);
-			for (int i = 0; i < model.appearanceModeWeights.cols(); i++) {
-				MatrixX r = model.appearanceModes.row(i).transpose();
-				Scalar s = innerSum(i, 0);
-				subtractedPart += s * r;
-			}
-			steepestDescentImg = gradA0dNdj - subtractedPart;
+    /** Sample the difference between image and mean appearance of cn channels for the given samples
+        of a shape instance in image coordinates. */
+    template<int cn>
+    void sampleDifferenceTyped(
+        const ActiveAppearanceModel& model, const cv::Mat& image, const cv::Point& offset, 
+        const std::vector<int>& indices, const RowVectorX& shape, Scalar *diff) 
+    {
+        const int nSamples = (int)indices.size();
+        const MatrixX &bary = model.barycentricSamplePositions;
+        const RowVectorXi &triangles = model.triangleIndices;
+        const Scalar *mean = model.appearanceMean.data();
+
+        // pixel coordinates are shifted by half a pixel, as sample positions are located on pixel centers.
+        const Scalar shiftX = Scalar(0.5);
+        const Scalar shiftY = Scalar(0.5);
+
+        // samples are ordered by triangle. Per triangle, shape warp and global transform are composed 
+        // into a single affine map from barycentric coordinates to pixel coordinates:
+        // x = o + alpha * u + beta * v
+        int lastTriangle = -1;
+        Scalar ox = 0, oy = 0, ux = 0, uy = 0, vx = 0, vy = 0;
+
+        for (int k = 0; k < nSamples; k++) {
+            const int i = indices[k];
+            const int t = (int)bary(i, 0);
+
+            if (t != lastTriangle) {
+                const Scalar *p0 = shape.data() + 2 * triangles(t * 3 + 0);
+                const Scalar *p1 = shape.data() + 2 * triangles(t * 3 + 1);
+                const Scalar *p2 = shape.data() + 2 * triangles(t * 3 + 2);
+                ox = p0[0] - shiftX;
+                oy = p0[1] - shiftY;
+                ux = p1[0] - p0[0];
+                uy = p1[1] - p0[1];
+                vx = p2[0] - p0[0];
+                vy = p2[1] - p0[1];
+                lastTriangle = t;
+            }
 
-			steepestDescentImgs.push_back(steepestDescentImg);
+            const Scalar alpha = bary(i, 1);
+            const Scalar beta = bary(i, 2);
 
-			std::cout << "calculated steepest descent image #" << j << " (" << paramIdx << ")" << std::endl;
+            Scalar *d = diff + k * cn;
+            sampleImageBilinear<cn>(image, offset, ox + alpha * ux + beta * vx, oy + alpha * uy + beta * vy, d);
+            for (int c = 0; c < cn; c++) {
+                d[c] -= mean[i * cn + c];
+            }
+        }
+    }
 
-			////////////////////////
-			// DEBUG
-		
-			MatrixX sd = 15 * steepestDescentImgs[j];
-			for (int r = 0; r < sd.rows(); r++) {
-				for (int c = 0; c < sd.cols(); c++) {
-					sd(r, c) += 128;
-					if (sd(r, c) > 255) {
-						sd(r, c) = 255;
-					}
-					if (sd(r, c) < 0) {
-						sd(r, c) = 0;
-					}
-				}
-			}
-			cv::Mat colors = toOpenCVHeader<aam::Scalar>(sd);
-			RowVectorX s0 = transformShape(model.shapeTransformToTrainingData, model.shapeMean);
-			cv::Mat image(800, 800, CV_8U);
-			image = cv::Scalar(0);
-			aam::writeShapeImage(s0, model.triangleIndices, model.barycentricSamplePositions, colors, image);
-			cv::imshow("steepestDescentImage", image);
-			cv::waitKey(10);
-
-			///////////////////////
-		}
-	}
+    bool Matcher2::init(const cv::Mat& img, Scalar x, Scalar y, Scalar scaling, aam::RowVectorX& shapeParams, aam::RowVectorX& appearanceParams) {
 
-	void calcInvHessianWarpAndTrafo(const std::vector<MatrixX>& sd, MatrixX& invHessian) {
-        invHessian = MatrixX::Zero(sd.size(), sd.size());
+        // bind the image by reference, no copy
+        setImage(img);
 
-		std::cout << "invHessian = " << invHessian.rows() << " x " << invHessian.cols() << std::endl;
+        const bool valid = algorithm == SIMULTANEOUS ? precomputeSimultaneous() : precomputeProjectOut();
+        if (!valid)
+            return false;
 
-		int numTextureSamples = sd[0].rows();
-		for (int i = 0; i < numTextureSamples; i++) {
-			for (int j = 0; j < sd.size(); j++) {
-				for (int k = 0; k < sd.size(); k++) {
-					invHessian(j, k) += sd[j](i, 0) * sd[k](i, 0);
-					//std::cout << "sd[j](i, 0) = " << sd[j](i, 0) << " sd[k](i, 0) = " << sd[k](i, 0) << std::endl;
-				}
-			}
-        }
+        sampleSubsets.clear();
+        allocateWorkspace();
+
+        reset(x, y, scaling, shapeParams, appearanceParams);
+        return true;
+    }
+
+    void Matcher2::allocateWorkspace() {
 
-        invHessian = invHessian.inverse();
+        const int nRows = (int)allSamples->indices.size() * model->appearanceChannels();
+        const int nShape = (int)model->shapeMean.cols();
+        const int nAppearanceParams = (int)model->appearanceModes.rows();
+        const int nTriangles = (int)model->triangleIndices.size() / 3;
 
-		//std::cout << "invHessian: " << std::endl << invHessian;
+        // the simultaneous algorithm estimates appearance parameters along with the shape
+        int nUnknowns = 4 + (int)model->shapeModes.rows();
+        if (algorithm == SIMULTANEOUS) {
+            nUnknowns += nAppearanceParams;
+        }
+
+        work.diffImage.resize(nRows, 1);
+        work.trialDiffImage.resize(nRows, 1);
+        work.errorImage.resize(nRows, 1);
+        work.residual.resize(nRows, 1);
+        work.weightedDiff.resize(nRows, 1);
+        work.absResiduals.resize(nRows);
+        work.triangleWeights.resize(nTriangles);
+        work.appearanceSystem.resize(nAppearanceParams, nAppearanceParams);
+        work.appearanceRhs.resize(nAppearanceParams, 1);
+        work.appearanceLdlt = Eigen::LDLT<TrainingMatrixX>(nAppearanceParams);
+        work.appearanceSolution.resize(nAppearanceParams, 1);
+        work.shape.resize(nShape);
+        work.sdDiff.resize(allSamples->steepestDescent.cols(), 1);
+        work.modesDiff.resize(nAppearanceParams, 1);
+        work.hessian.resize(nUnknowns, nUnknowns);
+        work.b.resize(nUnknowns, 1);
+        work.damped.resize(nUnknowns, nUnknowns);
+        work.ldlt = Eigen::LDLT<TrainingMatrixX>(nUnknowns);
+        work.solution.resize(nUnknowns, 1);
+        work.deltaParam.resize(nUnknowns, 1);
+        work.trialShapeParams.resize(model->shapeModes.rows());
+        work.trialAppearanceParams.resize(nAppearanceParams);
     }
 
-    void Matcher2::init(const cv::Mat& img, Scalar x, Scalar y, Scalar scaling, aam::RowVectorX& shapeParams, aam::RowVectorX& appearanceParams) {
+    bool Matcher2::init(const cv::Mat& img, const Affine2& pose, aam::RowVectorX& shapeParams, aam::RowVectorX& appearanceParams) {
+        if (!init(img, 0, 0, 1, shapeParams, appearanceParams))
+            return false;
 
-        image = img.clone();
+        setCurrentGlobalTransform(pose);
+        return true;
+    }
 
-        // calculate the gradient of the template (i.e. mean appearance image)
-        // gradients are 1x2
-        calcGradientOfMeanAppearance(image, model, grad);
+    bool Matcher2::precomputeProjectOut() {
 
-        // evaluate the global shape transform Jacobians at (x; 0)
-        // jacobians are 2x4 for global shape transform
-        evaluateJacobiansGlobalTransform(model, globalTrafoJacobians);
+        const int nSamples = (int)model->barycentricSamplePositions.rows();
+        const int nChannels = model->appearanceChannels();
+        const int nParams = 4 + (int)model->shapeModes.rows();
 
-        // evaluate the warp Jacobians at (x; 0)
-        evaluateWarpJacobians(model, warpJacobians);
+        std::shared_ptr<SampleSet> set = std::make_shared<SampleSet>();
 
         // compute modified steepest descent images using equations (63) and (64)
-		computeSteepestDescentImages(model, grad, globalTrafoJacobians, warpJacobians, steepestDescentImgs);
+        TrainingMatrixX sd(nSamples * nChannels, nParams);
+        computeSteepestDescentImages(*model, model->appearanceMeanGradient.cast<TrainingScalar>(), sd);
+        projectOutAppearanceVariation(*model, sd);
+        set->steepestDescent = sd.cast<Scalar>();
+
+        set->indices.resize(nSamples);
+        for (int i = 0; i < nSamples; i++) {
+            set->indices[i] = i;
+        }
+
+        if (!prepareSampleSet(*set))
+            return false;
+
+        allSamples = set;
+        return true;
+    }
+
+    bool Matcher2::precomputeSimultaneous() {
+
+        const int nSamples = (int)model->barycentricSamplePositions.rows();
+        const int nChannels = model->appearanceChannels();
+        const int nParams = 4 + (int)model->shapeModes.rows();
+        const int nAppearanceParams = (int)model->appearanceModes.rows();
+
+        // the steepest descent images of the simultaneous algorithm depend linearly on the 
+        // appearance parameters: SD(lambda) = SD_0 + sum_i lambda_i SD_i with SD_i = grad(A_i) dW/dp.
+        // pre-compute the blocks SD_i side by side.
+        std::shared_ptr<SampleSet> set = std::make_shared<SampleSet>();
+
+        TrainingMatrixX blocks(nSamples * nChannels, nParams * (nAppearanceParams + 1));
+        computeSteepestDescentImages(*model, model->appearanceMeanGradient.cast<TrainingScalar>(), blocks.leftCols(nParams));
 
-        // compute the inverse Hessian matrix (eq. 65)
-        // inverse hessian is 4x4
-        calcInvHessianWarpAndTrafo(steepestDescentImgs, invHessian);
+        RowVectorX s0 = transformShape(model->shapeTransformToTrainingData, model->shapeMean);
+        TrainingMatrixX modeGradient;
+        for (int i = 0; i < nAppearanceParams; i++) {
+            computeShapeImageGradient(s0, model->triangleIndices, model->barycentricSamplePositions, model->appearanceModes.row(i), modeGradient);
+            computeSteepestDescentImages(*model, modeGradient, blocks.middleCols((i + 1) * nParams, nParams));
+        }
+        set->steepestDescent = blocks.cast<Scalar>();
+
+        set->indices.resize(nSamples);
+        for (int i = 0; i < nSamples; i++) {
+            set->indices[i] = i;
+        }
+
+        if (!prepareSampleSet(*set))
+            return false;
+
+        allSamples = set;
+        return true;
+    }
+
+    bool Matcher2::prepareSampleSet(SampleSet& set) {
+
+        const int nChannels = model->appearanceChannels();
+
+        TrainingMatrixX sdT = set.steepestDescent.cast<TrainingScalar>();
+        TrainingMatrixX appearanceModesT = gatherCols(model->appearanceModes, channelIndices(set.indices, nChannels)).cast<TrainingScalar>();
+
+        // Appearance modes are orthonormal over all samples, but not over subsets. Too few or 
+        // degenerate samples leave appearance parameters undetermined.
+        set.appearanceGram = appearanceModesT * appearanceModesT.transpose();
+        Eigen::LDLT<TrainingMatrixX> gram(set.appearanceGram);
+        if (!hasFullRank(gram))
+            return false;
+
+        if (algorithm == SIMULTANEOUS) {
+            // pre-compute all block products, the Hessian per iteration becomes a weighted sum of those.
+            set.appearanceModes = appearanceModesT.cast<Scalar>();
+            set.blockProducts = sdT.transpose() * sdT;
+            set.appearanceProducts = sdT.transpose() * appearanceModesT.transpose();
+        } else {
+            // compute the Hessian matrix (eq. 65) in training precision, it is damped per step
+            set.hessian = sdT.transpose() * sdT;
+
+            // least squares fit of the appearance parameters on the samples of this set
+            set.appearanceModes = gram.solve(appearanceModesT).cast<Scalar>();
+
+            // per triangle contributions to the Hessian for robust fitting
+            const int nParams = (int)set.steepestDescent.cols();
+            const int nTriangles = (int)model->triangleIndices.size() / 3;
+
+            std::vector< std::vector<int> > rowsPerTriangle(nTriangles);
+            set.sampleTriangles.resize(set.indices.size() * nChannels);
+            for (size_t k = 0; k < set.indices.size(); k++) {
+                int t = (int)model->barycentricSamplePositions(set.indices[k], 0);
+                for (int c = 0; c < nChannels; c++) {
+                    set.sampleTriangles[k * nChannels + c] = t;
+                    rowsPerTriangle[t].push_back((int)k * nChannels + c);
+                }
+            }
+
+            set.triangleSampleCounts.resize(nTriangles);
+            set.triangleHessians.resize(nTriangles * nParams, nParams);
+            for (int t = 0; t < nTriangles; t++) {
+                set.triangleSampleCounts[t] = (int)rowsPerTriangle[t].size();
+                TrainingMatrixX sdTri = gatherRows(set.steepestDescent, rowsPerTriangle[t]).cast<TrainingScalar>();
+                set.triangleHessians.middleRows(t * nParams, nParams) = sdTri.transpose() * sdTri;
+            }
+        }
+
+        return true;
+    }
+
+    void Matcher2::setRobustError(RobustError error, Scalar scale) {
+        robustError = error;
+        robustScale = scale;
+    }
+
+    /** Weight of a residual normalized by scale for the given M-estimator */
+    inline Scalar robustWeight(Matcher2::RobustError error, Scalar u) {
+        u = std::abs(u);
+        switch (error) {
+            case Matcher2::HUBER: {
+                const Scalar c = Scalar(1.345);
+                return u <= c ? Scalar(1) : c / u;
+            }
+            case Matcher2::TUKEY: {
+                const Scalar c = Scalar(4.685);
+                if (u >= c)
+                    return Scalar(0);
+                Scalar r = 1 - (u / c) * (u / c);
+                return r * r;
+            }
+            case Matcher2::CAUCHY: {
+                const Scalar c = Scalar(2.385);
+                return Scalar(1) / (1 + (u / c) * (u / c));
+            }
+            default:
+                return Scalar(1);
+        }
+    }
+
+    void Matcher2::setSampleSubsets(SampleSelection selection, int nbSamples, int nbSubsets) {
+
+        const int nSamples = (int)allSamples->indices.size();
+        const int nChannels = model->appearanceChannels();
+        const int nParams = 4 + (int)model->shapeModes.rows();
+        const int nAppearanceParams = (int)model->appearanceModes.rows();
+
+        // each subset needs at least as many entries as unknowns of the appearance fit and the update
+        const int minSamples = (std::max(nParams, nAppearanceParams) + nChannels - 1) / nChannels;
+        nbSamples = std::min(std::max(nbSamples, minSamples), nSamples);
+
+        std::vector< std::shared_ptr<SampleSet> > subsets;
+
+        if (selection == GRADIENT_MAGNITUDE) {
+            // samples with largest steepest descent magnitude (w.r.t. mean appearance, summed over 
+            // channels) in a single subset
+            RowVectorX entryMagnitude = allSamples->steepestDescent.leftCols(nParams).rowwise().squaredNorm().transpose();
+            RowVectorX magnitude(nSamples);
+            for (int i = 0; i < nSamples; i++) {
+                magnitude(i) = entryMagnitude.segment(i * nChannels, nChannels).sum();
+            }
+
+            std::vector<int> order(allSamples->indices);
+            std::nth_element(order.begin(), order.begin() + (nbSamples - 1), order.end(), 
+                [&magnitude](int a, int b) { return magnitude(a) > magnitude(b); });
+
+            std::shared_ptr<SampleSet> set = std::make_shared<SampleSet>();
+            set->indices.assign(order.begin(), order.begin() + nbSamples);
+            subsets.push_back(set);
+        } else {
+            // group samples by triangle
+            std::vector< std::vector<int> > samplesPerTriangle(model->triangleIndices.size() / 3);
+            for (int i = 0; i < nSamples; i++) {
+                samplesPerTriangle[(int)model->barycentricSamplePositions(i, 0)].push_back(i);
+            }
+
+            // draw the same fraction of samples from each triangle
+            for (int s = 0; s < std::max(nbSubsets, 1); s++) {
+                std::shared_ptr<SampleSet> set = std::make_shared<SampleSet>();
+                for (size_t t = 0; t < samplesPerTriangle.size(); t++) {
+                    std::vector<int> &ts = samplesPerTriangle[t];
+                    if (ts.empty())
+                        continue;
+                    int n = std::max(1, (int)((long long)ts.size() * nbSamples / nSamples));
+                    n = std::min(n, (int)ts.size());
+                    for (int i = 0; i < n; i++) {
+                        std::uniform_int_distribution<int> pick(i, (int)ts.size() - 1);
+                        std::swap(ts[i], ts[pick(rng)]);
+                    }
+                    set->indices.insert(set->indices.end(), ts.begin(), ts.begin() + n);
+                }
+                subsets.push_back(set);
+            }
+        }
+
+        // sample in memory order and pre-compute per subset, degenerate subsets are dropped
+        sampleSubsets.clear();
+        for (size_t s = 0; s < subsets.size(); s++) {
+            SampleSet &set = *subsets[s];
+            std::sort(set.indices.begin(), set.indices.end());
+            set.steepestDescent = gatherRows(allSamples->steepestDescent, channelIndices(set.indices, nChannels));
+            if (prepareSampleSet(set)) {
+                sampleSubsets.push_back(subsets[s]);
+            }
+        }
+    }
+
+    void Matcher2::useAllSamples() {
+        sampleSubsets.clear();
+    }
+
+    void Matcher2::setSeed(unsigned int seed) {
+        rng.seed(seed);
+    }
+
+    void Matcher2::reset(Scalar x, Scalar y, Scalar scaling, const aam::RowVectorX& shapeParams, const aam::RowVectorX& appearanceParams) {
 
 		currentShapeParams = shapeParams;
         currentAppearanceParams = appearanceParams;
+        if (currentAppearanceParams.cols() != model->appearanceModes.rows()) {
+            currentAppearanceParams.setZero(model->appearanceModes.rows());
+        }
 
         // initialize the warp with the transform to training data
-        currentWarp = model.shapeTransformToTrainingData;
+        currentWarp = model->shapeTransformToTrainingData;
         currentWarp(2, 0) = x;
         currentWarp(2, 1) = y;
         currentWarp(0, 0) *= scaling;
         currentWarp(1, 1) *= scaling;
+
+        damping = initialDamping;
     }
 
     void Matcher2::step() {
+        AAM_SCOPED_TIMER(FIT_STEP);
+        AAM_COUNT(FIT_STEP, 1);
+
+        // choose the samples to fit on in this step
+        const SampleSet *set = allSamples.get();
+        if (sampleSubsets.size() == 1) {
+            set = sampleSubsets.front().get();
+        } else if (sampleSubsets.size() > 1) {
+            std::uniform_int_distribution<int> pick(0, (int)sampleSubsets.size() - 1);
+            set = sampleSubsets[pick(rng)].get();
+        }
 
-		// calculate cartesian sample positions for the current shape
-        model.getCartesianPixelCoordinates(Affine2::Identity(), currentShapeParams, coords);
-
-        // reset root mean squared error, reset parameter update
-        aam::Scalar rms = 0;
-		int nbParams = 4 + model.shapeModeWeights.cols();
-		MatrixX deltaParam = MatrixX::Zero(nbParams, 1);
-
-		MatrixX diffImage = MatrixX::Zero(coords.size(), 1);
-
-        // for each sample position...
-        for (size_t i = 0; i < coords.size(); i++) {
-
-            // get the cartesian coordinates (calculated above)
-            RowVector2 pt = coords[i];
-
-            // get the corresponding transformed point
-            RowVector2 warpedPt = transformShape(currentWarp, pt);
+        // leading rows of the workspace hold the samples of the chosen set
+        const int nRows = (int)set->indices.size() * model->appearanceChannels();
+        Eigen::Ref<MatrixX> diffImage = work.diffImage.topRows(nRows);
+        Eigen::Ref<MatrixX> errorImage = work.errorImage.topRows(nRows);
+        Eigen::Ref<MatrixX> trialDiffImage = work.trialDiffImage.topRows(nRows);
 
-            // get gray values from mean appearance model and image
-            aam::Scalar gModel = model.appearanceMean(i);
-            aam::Scalar gImg = image.at<unsigned char>((int)warpedPt(0, 1), (int)warpedPt(0, 0));
+        sampleDifference(*set, currentWarp, currentShapeParams, diffImage);
 
-			diffImage(i, 0) = gImg - gModel;
-        }
+        // root mean squared error of the current fit (before applying this step's update)
+        currentError = measureError(*set, diffImage, errorImage);
 
+#ifdef AAM_MATCHER_VERBOSE
 		////////////////////////
 		// DEBUG
 		
-		MatrixX sd = 5 * diffImage;
+		MatrixX sd = 5 * errorImage;
 		for (int r = 0; r < sd.rows(); r++) {
 			for (int c = 0; c < sd.cols(); c++) {
 				sd(r, c) += 128;
@@ -540,74 +936,375 @@ namespace aam {
 			}
 		}
 		cv::Mat colors = toOpenCVHeader<aam::Scalar>(sd);
-		RowVectorX s0 = transformShape(model.shapeTransformToTrainingData, model.shapeMean);
+		RowVectorX s0 = transformShape(model->shapeTransformToTrainingData, model->shapeMean);
 		cv::Mat image(800, 800, CV_8U);
 		image = cv::Scalar(0);
-		aam::writeShapeImage(s0, model.triangleIndices, model.barycentricSamplePositions, colors, image);
+		aam::writeShapeImage(s0, model->triangleIndices, model->barycentricSamplePositions, colors, image);
 		cv::imshow("diffImage", image);
 		cv::waitKey(10);
 
 		///////////////////////
+#endif
+
+        // Gauss-Newton system (steps 7 and 8, Figure 13, AAMs revisited)
+        const Scalar scale = linearize(*set, diffImage, errorImage);
+        const Scalar error = evaluateError(*set, diffImage, currentAppearanceParams, scale);
+
+        // Levenberg-Marquardt: increase the damping until the update decreases the error. Trial 
+        // updates only require sampling the image, the linearization is reused.
+        for (int trial = 0; trial < maxDampingTrials; trial++) {
+            AAM_SCOPED_TIMER(FIT_TRIAL);
+            AAM_COUNT(FIT_TRIAL, 1);
+
+            Affine2 warp = currentWarp;
+            work.trialShapeParams = currentShapeParams;
+            work.trialAppearanceParams = currentAppearanceParams;
+            solveDampedUpdate(warp, work.trialShapeParams, work.trialAppearanceParams);
+
+            sampleDifference(*set, warp, work.trialShapeParams, trialDiffImage);
+            if (algorithm == PROJECT_OUT && robustError == LEAST_SQUARES) {
+                work.trialAppearanceParams.transpose().noalias() = set->appearanceModes * trialDiffImage;
+            } else if (algorithm == PROJECT_OUT) {
+                estimateAppearanceRobust(*set, trialDiffImage, scale, work.trialAppearanceParams);
+            }
 
-		// Step 7, Figure 13 (AAMs revisited)
-		for (int j = 0; j < nbParams; j++) {
-			MatrixX sd = steepestDescentImgs[j];
-			deltaParam(j, 0) = sd.transpose().row(0) * diffImage.col(0); 
-		}
+            if (evaluateError(*set, trialDiffImage, work.trialAppearanceParams, scale) < error) {
+                currentWarp = warp;
+                currentShapeParams = work.trialShapeParams;
+                currentAppearanceParams = work.trialAppearanceParams;
+                damping = std::max(damping * Scalar(0.1), minDamping);
+                break;
+            }
 
-		std::cout << "invHessian = " << invHessian.rows() << " x " << invHessian.cols() << std::endl;
-		std::cout << "invHessian = " << invHessian << std::endl;
-		std::cout << "deltaParam = " << deltaParam.rows() << " x " << deltaParam.cols() << std::endl;
+            damping = std::min(damping * Scalar(10), maxDamping);
+        }
 
-        // (step 8 in figure 13, AAMs revisited)
-        deltaParam = invHessian * deltaParam * aam::Scalar(0.1);  // update with weight 0.1, TODO: remove this artificial weighting of the update
-		std::cout << "deltaParam: " << deltaParam << std::endl;
+#ifdef AAM_MATCHER_VERBOSE
+        std::cout << "Root Mean Squared Error = " << currentError << std::endl;
 
-		MatrixX deltaParamTrafo = deltaParam.block(0, 0, 4, 1);
-		MatrixX deltaParamShape = deltaParam.block(4, 0, model.shapeModeWeights.cols(), 1);
+        std::cout << "damping = " << damping << std::endl;
 
-        currentShapeParams += deltaParamShape * aam::Scalar(0.1);
+        std::cout << std::endl << "current warp: " << std::endl << currentWarp << std::endl;
+#endif
+    }
 
-        // get the current warp as 3x3 matrix
-        MatrixX currentWarp3x3(3, 3);
-        currentWarp3x3.block<3, 2>(0, 0) = currentWarp;
-        currentWarp3x3(0, 2) = 0;
-        currentWarp3x3(1, 2) = 0;
-        currentWarp3x3(2, 2) = 1;
+    void Matcher2::sampleDifference(const SampleSet& set, const Affine2& warp, const RowVectorX& shapeParams, Eigen::Ref<MatrixX> diffImage) {
 
-        // get the warp update as 3x3 matrix (derive from deltaParam)
-        MatrixX updateWarp3x3(3, 3);
-        updateWarp3x3.block<3, 2>(0, 0) = paramsToWarp(deltaParamTrafo);
-        updateWarp3x3(0, 2) = 0;
-        updateWarp3x3(1, 2) = 0;
-        updateWarp3x3(2, 2) = 1;
+        const int nChannels = model->appearanceChannels();
+        eigen_assert(image.depth() == CV_8U && image.channels() == nChannels);
+        eigen_assert(diffImage.rows() == (MatrixX::Index)set.indices.size() * nChannels);
 
-        // use this to exclude rotation and scaling from update
-        //updateWarp3x3(0, 0) = 1;
-        //updateWarp3x3(1, 1) = 1;
-        //updateWarp3x3(0, 1) = 0;
-        //updateWarp3x3(1, 0) = 0;
+        // shape instance in image coordinates
+        {
+            AAM_SCOPED_TIMER(FIT_COORDINATES);
+            model->reconstructShape(shapeParams, work.shape);
+            transformShapeInPlace(warp, work.shape);
 
-        // update the current warp (step 9 in figure 7, AAMs revisited)
-        // switch sequence in multiplication of warp matrices compared to AAMs revisited paper
-        // (as we are using row vectors, so vectors would be multiplied from left side)
-        currentWarp = (updateWarp3x3.inverse() * currentWarp3x3).block<3, 2>(0, 0);
+            // keep samples inside the bound region
+            if (roiMargin >= 0) {
+                updateImageROI(work.shape);
+            }
+        }
+
+        AAM_SCOPED_TIMER(FIT_SAMPLING);
+        AAM_COUNT(FIT_SAMPLING, set.indices.size());
 
-        // Step 10, Figure 13 (AAMs revisited)
-        currentAppearanceParams = RowVectorX::Zero(model.appearanceModes.rows());
-        for (int i = 0; i < model.appearanceModes.rows(); i++) {
-            currentAppearanceParams(i) = model.appearanceModes.row(i) * diffImage.col(0);
+        // number of channels dispatched once per call
+        if (nChannels == 3) {
+            sampleDifferenceTyped<3>(*model, image, imageOffset, set.indices, work.shape, diffImage.data());
+        } else {
+            sampleDifferenceTyped<1>(*model, image, imageOffset, set.indices, work.shape, diffImage.data());
         }
+    }
 
-        // calculate the root mean squared error (should be minimized by this optimization procedure)
-        rms = sqrt(rms / coords.size());
-        std::cout << "Root Mean Squared Error = " << rms << std::endl;
+    Scalar Matcher2::measureCurrentError() {
 
-        std::cout << std::endl << "delta Params 3x3: " << std::endl << updateWarp3x3 << std::endl;
+        const SampleSet &set = *allSamples;
+        const int nRows = (int)set.indices.size() * model->appearanceChannels();
+        Eigen::Ref<MatrixX> diffImage = work.diffImage.topRows(nRows);
+        Eigen::Ref<MatrixX> errorImage = work.errorImage.topRows(nRows);
 
-        std::cout << std::endl << "delta Params (4x1): " << std::endl << deltaParam << std::endl;
+        sampleDifference(set, currentWarp, currentShapeParams, diffImage);
 
-        std::cout << std::endl << "current warp: " << std::endl << currentWarp << std::endl;
+        // project-out estimates the appearance from the difference, the simultaneous algorithm keeps its own
+        work.trialAppearanceParams = currentAppearanceParams;
+        if (algorithm == PROJECT_OUT && robustError == LEAST_SQUARES) {
+            work.trialAppearanceParams.transpose().noalias() = set.appearanceModes * diffImage;
+        } else if (algorithm == PROJECT_OUT) {
+            estimateAppearanceRobust(set, diffImage, robustScale, work.trialAppearanceParams);
+        }
+
+        AAM_SCOPED_TIMER(FIT_RESIDUAL);
+        appearanceResidual(set, diffImage, work.trialAppearanceParams, errorImage);
+        return std::sqrt(errorImage.squaredNorm() / (Scalar)nRows);
+    }
+
+    void Matcher2::appearanceResidual(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, const RowVectorX& appearanceParams, Eigen::Ref<MatrixX> residual) const {
+        residual = diffImage;
+        residual.noalias() -= set.appearanceModes.transpose() * appearanceParams.transpose();
+    }
+
+    Scalar Matcher2::measureError(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, Eigen::Ref<MatrixX> errorImage) const {
+        AAM_SCOPED_TIMER(FIT_RESIDUAL);
+
+        // the simultaneous algorithm measures the error with respect to the current appearance
+        if (algorithm == SIMULTANEOUS) {
+            appearanceResidual(set, diffImage, currentAppearanceParams, errorImage);
+        } else {
+            errorImage = diffImage;
+        }
+
+        return std::sqrt(errorImage.squaredNorm() / (Scalar)errorImage.rows());
+    }
+
+    /** Loss of a residual normalized by scale for the given M-estimator, matching robustWeight */
+    inline Scalar robustLoss(Matcher2::RobustError error, Scalar u) {
+        u = std::abs(u);
+        switch (error) {
+            case Matcher2::HUBER: {
+                const Scalar c = Scalar(1.345);
+                return u <= c ? Scalar(0.5) * u * u : c * (u - Scalar(0.5) * c);
+            }
+            case Matcher2::TUKEY: {
+                const Scalar c = Scalar(4.685);
+                if (u >= c)
+                    return c * c / 6;
+                Scalar r = 1 - (u / c) * (u / c);
+                return c * c / 6 * (1 - r * r * r);
+            }
+            case Matcher2::CAUCHY: {
+                const Scalar c = Scalar(2.385);
+                return Scalar(0.5) * c * c * std::log(1 + (u / c) * (u / c));
+            }
+            default:
+                return Scalar(0.5) * u * u;
+        }
+    }
+
+    /** lambda^T G lambda accumulated in training precision */
+    inline TrainingScalar gramNorm(const TrainingMatrixX& gram, const RowVectorX& lambda) {
+        TrainingScalar sum = 0;
+        for (TrainingMatrixX::Index i = 0; i < gram.rows(); i++) {
+            sum += (TrainingScalar)lambda(i) * gram.row(i).dot(lambda.cast<TrainingScalar>());
+        }
+        return sum;
+    }
+
+    Scalar Matcher2::evaluateError(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, const RowVectorX& appearanceParams, Scalar scale) {
+        AAM_SCOPED_TIMER(FIT_RESIDUAL);
+
+        if (algorithm == SIMULTANEOUS) {
+            // |d - A^T lambda|^2 = |d|^2 - 2 lambda^T A d + lambda^T G lambda, without reconstructing the appearance
+            work.modesDiff.noalias() = set.appearanceModes * diffImage;
+            TrainingScalar cross = appearanceParams.cast<TrainingScalar>().dot(work.modesDiff.col(0).transpose().cast<TrainingScalar>());
+            TrainingScalar gram = gramNorm(set.appearanceGram, appearanceParams);
+            return (Scalar)(diffImage.cast<TrainingScalar>().squaredNorm() - 2 * cross + gram);
+        }
+
+        if (robustError == LEAST_SQUARES) {
+            // squared norm of the difference projected out of the appearance subspace. With least
+            // squares appearance parameters this is |d|^2 - lambda^T G lambda.
+            TrainingScalar projected = gramNorm(set.appearanceGram, appearanceParams);
+            return (Scalar)(diffImage.cast<TrainingScalar>().squaredNorm() - projected);
+        }
+
+        // robust loss of the residual projected out of the appearance subspace
+        Eigen::Ref<MatrixX> residual = work.residual.topRows(diffImage.rows());
+        appearanceResidual(set, diffImage, appearanceParams, residual);
+
+        Scalar sum = 0;
+        for (MatrixX::Index k = 0; k < residual.rows(); k++) {
+            sum += robustLoss(robustError, residual(k, 0) / scale);
+        }
+        return sum;
+    }
+
+    void Matcher2::applyUpdate(const MatrixX& delta, Affine2& warp, RowVectorX& shapeParams, RowVectorX& appearanceParams) const {
+
+        const int nShapeParams = (int)model->shapeModes.rows();
+
+        // first order approximation of the inverse shape warp update
+        shapeParams -= delta.block(4, 0, nShapeParams, 1).transpose();
+
+        // update the warp (step 9 in figure 7, AAMs revisited)
+        warp = composeInverseUpdate(warp, delta);
+
+        // appearance enters linearly, apply its update additively
+        if (delta.rows() > 4 + nShapeParams) {
+            appearanceParams += delta.bottomRows(delta.rows() - 4 - nShapeParams).transpose();
+        }
+    }
+
+    Scalar Matcher2::linearize(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, const Eigen::Ref<const MatrixX>& errorImage) {
+        AAM_SCOPED_TIMER(FIT_UPDATE);
+
+        Scalar scale = 0;
+        if (algorithm == SIMULTANEOUS) {
+            linearizeSimultaneous(set, errorImage, work.hessian, work.b);
+        } else if (robustError == LEAST_SQUARES) {
+            linearizeProjectOut(set, diffImage, work.hessian, work.b);
+
+            // Step 10, Figure 13 (AAMs revisited)
+            currentAppearanceParams.transpose().noalias() = set.appearanceModes * diffImage;
+        } else {
+            // weight what the appearance subspace does not explain, not the raw difference. Outliers 
+            // would bias least squares appearance parameters, so these are estimated robustly as well.
+            estimateAppearanceRobust(set, diffImage, robustScale, currentAppearanceParams);
+
+            Eigen::Ref<MatrixX> residual = work.residual.topRows(diffImage.rows());
+            appearanceResidual(set, diffImage, currentAppearanceParams, residual);
+            scale = linearizeProjectOutRobust(set, residual, work.hessian, work.b);
+        }
+
+        return scale;
+    }
+
+    void Matcher2::solveDampedUpdate(Affine2& warp, RowVectorX& shapeParams, RowVectorX& appearanceParams) {
+        AAM_SCOPED_TIMER(FIT_UPDATE);
+
+        // (H + damping * diag(H)) delta = b, see solveDamped
+        work.damped = work.hessian;
+        work.damped.diagonal() *= 1 + damping;
+        work.ldlt.compute(work.damped);
+        work.solution = work.ldlt.solve(work.b);
+        work.deltaParam = work.solution.cast<Scalar>();
+
+#ifdef AAM_MATCHER_VERBOSE
+        std::cout << "deltaParam: " << work.deltaParam << std::endl;
+#endif
+
+        applyUpdate(work.deltaParam, warp, shapeParams, appearanceParams);
+    }
+
+    void Matcher2::linearizeProjectOut(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, TrainingMatrixX& hessian, TrainingMatrixX& b) {
+        hessian = set.hessian;
+        work.sdDiff.noalias() = set.steepestDescent.transpose() * diffImage;
+        b = work.sdDiff.cast<TrainingScalar>();
+    }
+
+    Scalar Matcher2::estimateScale(const Eigen::Ref<const MatrixX>& residual) {
+
+        const int nSamples = (int)residual.rows();
+
+        // scale of residuals, robustly estimated from the median absolute residual unless given
+        Scalar scale = robustScale;
+        if (scale <= 0) {
+            std::vector<Scalar>& absResiduals = work.absResiduals;
+            for (int k = 0; k < nSamples; k++) {
+                absResiduals[k] = std::abs(residual(k, 0));
+            }
+            std::nth_element(absResiduals.begin(), absResiduals.begin() + nSamples / 2, absResiduals.begin() + nSamples);
+            scale = Scalar(1.4826) * absResiduals[nSamples / 2];
+        }
+        return std::max(scale, std::numeric_limits<Scalar>::epsilon());
+    }
+
+    void Matcher2::estimateAppearanceRobust(const SampleSet& set, const Eigen::Ref<const MatrixX>& diffImage, Scalar scale, RowVectorX& appearanceParams) {
+
+        const int nRows = (int)diffImage.rows();
+        const int nAppearanceParams = (int)set.appearanceModes.rows();
+        const MatrixX &modes = set.appearanceModes;
+
+        Eigen::Ref<MatrixX> residual = work.residual.topRows(nRows);
+        TrainingMatrixX &system = work.appearanceSystem;
+        TrainingMatrixX &rhs = work.appearanceRhs;
+
+        for (int iteration = 0; iteration < robustAppearanceIterations; iteration++) {
+            appearanceResidual(set, diffImage, appearanceParams, residual);
+            const Scalar s = scale > 0 ? scale : estimateScale(residual);
+
+            // weighted normal equations (A W A^T) lambda = A W d, lower triangle only
+            system.setZero();
+            rhs.setZero();
+            for (int k = 0; k < nRows; k++) {
+                const TrainingScalar w = robustWeight(robustError, residual(k, 0) / s);
+                if (w <= 0)
+                    continue;
+                for (int i = 0; i < nAppearanceParams; i++) {
+                    const TrainingScalar wa = w * modes(i, k);
+                    rhs(i, 0) += wa * diffImage(k, 0);
+                    for (int j = 0; j <= i; j++) {
+                        system(i, j) += wa * modes(j, k);
+                    }
+                }
+            }
+
+            // keep the current estimate if outliers leave the parameters undetermined
+            work.appearanceLdlt.compute(system);
+            if (!hasFullRank(work.appearanceLdlt))
+                return;
+
+            work.appearanceSolution = work.appearanceLdlt.solve(rhs);
+            appearanceParams = work.appearanceSolution.transpose().cast<Scalar>();
+        }
+    }
+
+    Scalar Matcher2::linearizeProjectOutRobust(const SampleSet& set, const Eigen::Ref<const MatrixX>& residual, TrainingMatrixX& hessian, TrainingMatrixX& b) {
+
+        const int nSamples = (int)residual.rows();
+        const int nParams = (int)set.steepestDescent.cols();
+        const int nTriangles = (int)set.triangleSampleCounts.size();
+
+        const Scalar scale = estimateScale(residual);
+
+        // weights per sample and mean weight per triangle
+        Eigen::Ref<MatrixX> weightedDiff = work.weightedDiff.topRows(nSamples);
+        std::vector<TrainingScalar>& triangleWeights = work.triangleWeights;
+        std::fill(triangleWeights.begin(), triangleWeights.end(), TrainingScalar(0));
+        for (int k = 0; k < nSamples; k++) {
+            Scalar w = robustWeight(robustError, residual(k, 0) / scale);
+            weightedDiff(k, 0) = w * residual(k, 0);
+            triangleWeights[set.sampleTriangles[k]] += w;
+        }
+
+        // weighted Hessian, assuming weights to be constant per triangle
+        hessian.setZero(nParams, nParams);
+        for (int t = 0; t < nTriangles; t++) {
+            if (set.triangleSampleCounts[t] > 0) {
+                hessian += (triangleWeights[t] / set.triangleSampleCounts[t]) * set.triangleHessians.middleRows(t * nParams, nParams);
+            }
+        }
+
+        work.sdDiff.noalias() = set.steepestDescent.transpose() * weightedDiff;
+        b = work.sdDiff.cast<TrainingScalar>();
+
+        return scale;
+    }
+
+    void Matcher2::linearizeSimultaneous(const SampleSet& set, const Eigen::Ref<const MatrixX>& errorImage, TrainingMatrixX& hessian, TrainingMatrixX& b) {
+
+        const int nParams = 4 + (int)model->shapeModes.rows();
+        const int nAppearanceParams = (int)model->appearanceModes.rows();
+        const int nBlocks = nAppearanceParams + 1;
+
+        // weights of the steepest descent blocks: 1, lambda_0, lambda_1, ...
+        auto w = [this](int i) { return i == 0 ? TrainingScalar(1) : (TrainingScalar)currentAppearanceParams(i - 1); };
+
+        // steepest descent parameter updates for all blocks at once
+        work.sdDiff.noalias() = set.steepestDescent.transpose() * errorImage;
+        work.modesDiff.noalias() = set.appearanceModes * errorImage;
+
+        b.resize(nParams + nAppearanceParams, 1);
+        b.topRows(nParams).setZero();
+        for (int i = 0; i < nBlocks; i++) {
+            b.topRows(nParams) += w(i) * work.sdDiff.middleRows(i * nParams, nParams).cast<TrainingScalar>();
+        }
+        b.bottomRows(nAppearanceParams) = work.modesDiff.cast<TrainingScalar>();
+
+        // assemble the Hessian from the pre-computed block products.
+        hessian.resize(nParams + nAppearanceParams, nParams + nAppearanceParams);
+        hessian.topLeftCorner(nParams, nParams).setZero();
+        hessian.topRightCorner(nParams, nAppearanceParams).setZero();
+        hessian.bottomRightCorner(nAppearanceParams, nAppearanceParams) = set.appearanceGram;
+        for (int i = 0; i < nBlocks; i++) {
+            for (int j = 0; j < nBlocks; j++) {
+                hessian.topLeftCorner(nParams, nParams) += 
+                    (w(i) * w(j)) * set.blockProducts.block(i * nParams, j * nParams, nParams, nParams);
+            }
+            hessian.topRightCorner(nParams, nAppearanceParams) += 
+                w(i) * set.appearanceProducts.middleRows(i * nParams, nParams);
+        }
+        hessian.bottomLeftCorner(nAppearanceParams, nParams) = hessian.topRightCorner(nParams, nAppearanceParams).transpose();
     }
 
-}
+}
\ No newline at end of file
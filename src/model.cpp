@@ -70,38 +70,77 @@ namespace aam {
         return true;
     }
 
-    /** Draw the given model instance (shape only) to an image */
-    void ActiveAppearanceModel::renderShapeInstanceToImage(cv::Mat& image, MatrixX trafo, RowVectorX shapeParameters) 
+    void ActiveAppearanceModel::reconstructShape(Eigen::Ref<const RowVectorX> shapeParameters, Eigen::Ref<RowVectorX> shape) const
+    {
+        shape = shapeMean;
+        shape.noalias() += shapeParameters * shapeModes;
+    }
+
+    void ActiveAppearanceModel::projectShape(Eigen::Ref<const RowVectorX> shape, Eigen::Ref<RowVectorX> shapeParameters) const
+    {
+        // modes are orthonormal, (s - mean) * modes^T without forming the difference
+        shapeParameters.noalias() = shape * shapeModes.transpose();
+        shapeParameters.noalias() -= shapeMean * shapeModes.transpose();
+    }
+
+    void ActiveAppearanceModel::reconstructAppearance(Eigen::Ref<const RowVectorX> appearanceParameters, Eigen::Ref<RowVectorX> appearance) const
+    {
+        appearance = appearanceMean;
+        appearance.noalias() += appearanceParameters * appearanceModes;
+    }
+
+    void ActiveAppearanceModel::projectAppearance(Eigen::Ref<const RowVectorX> appearance, Eigen::Ref<RowVectorX> appearanceParameters) const
     {
+        // modes are orthonormal, (a - mean) * modes^T without forming the difference
+        appearanceParameters.noalias() = appearance * appearanceModes.transpose();
+        appearanceParameters.noalias() -= appearanceMean * appearanceModes.transpose();
+    }
+
+    int ActiveAppearanceModel::appearanceChannels() const
+    {
+        if (barycentricSamplePositions.rows() == 0) {
+            return 1;
+        }
+        return (int)(appearanceMean.cols() / barycentricSamplePositions.rows());
+    }
 
-        if (trafo.rows() == 0) {
-            trafo = shapeTransformToTrainingData;
+    /** Draw the given model instance (shape only) to an image */
+    void ActiveAppearanceModel::renderShapeInstanceToImage(cv::Mat& image, Eigen::Ref<const MatrixX> trafo, Eigen::Ref<const RowVectorX> shapeParameters) const
+    {
+        Affine2 t = shapeTransformToTrainingData;
+        if (trafo.rows() != 0) {
+            t = trafo;
         }
 
-        RowVectorX s = transformShape(trafo, shapeMean + (shapeParameters * shapeModes).colwise().sum());
+        RowVectorX s(shapeMean.cols());
+        reconstructShape(shapeParameters, s);
+        transformShapeInPlace(t, s);
 
         aam::drawShapeTriangulation(image, s, triangleIndices, cv::Scalar(128));
         aam::drawShapeLandmarks(image, s, cv::Scalar(255));
     }
 
     /** Draw the given model instance (including shape and texture) to an image */
-    void ActiveAppearanceModel::renderAppearanceInstanceToImage(cv::Mat& image, MatrixX trafo, RowVectorX shapeParameters, RowVectorX appearanceParameters, bool drawShape) 
+    void ActiveAppearanceModel::renderAppearanceInstanceToImage(cv::Mat& image, Eigen::Ref<const MatrixX> trafo, Eigen::Ref<const RowVectorX> shapeParameters, Eigen::Ref<const RowVectorX> appearanceParameters, bool drawShape) const
     {
-
-        if (trafo.rows() == 0) {
-            trafo = shapeTransformToTrainingData;
+        Affine2 t = shapeTransformToTrainingData;
+        if (trafo.rows() != 0) {
+            t = trafo;
         }
 
         RowVectorX s0 = transformShape(shapeTransformToTrainingData, shapeMean);
 
-        RowVectorX appearance = appearanceMean + (appearanceParameters * appearanceModes).colwise().sum();
-        MatrixX appearanceTransposed = appearance.transpose();
-        cv::Mat colors = toOpenCVHeader<aam::Scalar>(appearanceTransposed);
+        // a row vector shares its memory layout with a column vector
+        MatrixX appearance(appearanceMean.cols(), 1);
+        reconstructAppearance(appearanceParameters, appearance.transpose());
+        cv::Mat colors = toOpenCVHeader<aam::Scalar>(appearance).reshape(appearanceChannels(), (int)barycentricSamplePositions.rows());
 
         cv::Mat meanShapeImage = image.clone();
         aam::writeShapeImage(s0, triangleIndices, barycentricSamplePositions, colors, meanShapeImage);
 
-        aam::RowVectorX shape = aam::transformShape(trafo, shapeMean + (shapeParameters * shapeModes).colwise().sum());
+        aam::RowVectorX shape(shapeMean.cols());
+        reconstructShape(shapeParameters, shape);
+        aam::transformShapeInPlace(t, shape);
         aam::MatrixX barys = aam::rasterizeShape(shape, triangleIndices, image.cols, image.rows);
 
         // read texture image from mean shape image (texture samples need to be interpolated)
@@ -117,31 +156,46 @@ namespace aam {
         }
     }
 
-    void ActiveAppearanceModel::getCartesianPixelCoordinates(MatrixX trafo, RowVectorX shapeParameters, std::vector<aam::RowVector2>& coordinates) 
+    void ActiveAppearanceModel::getCartesianPixelCoordinates(Eigen::Ref<const MatrixX> trafo, Eigen::Ref<const RowVectorX> shapeParameters, std::vector<aam::RowVector2>& coordinates) const
     {
-        aam::RowVectorX shape = aam::transformShape(trafo, shapeMean + (shapeParameters * shapeModes).colwise().sum());
-
-        aam::barycentricToCartesian(shape, this->triangleIndices, this->barycentricSamplePositions, coordinates);
+        const Affine2 t = trafo;
+
+        coordinates.resize(barycentricSamplePositions.rows());
+
+        // samples are ordered by triangle, reconstruct and transform the vertices of one triangle at a time
+        int lastTriangle = -1;
+        RowVector2 v0, u, v;
+        for (MatrixX::Index i = 0; i < barycentricSamplePositions.rows(); ++i) {
+            const int triangle = (int)barycentricSamplePositions(i, 0);
+            if (triangle != lastTriangle) {
+                RowVector2 p[3];
+                for (int j = 0; j < 3; ++j) {
+                    const int k = triangleIndices(triangle * 3 + j);
+                    RowVector2 q = shapeMean.segment<2>(2 * k);
+                    q.noalias() += shapeParameters * shapeModes.middleCols<2>(2 * k);
+                    p[j].noalias() = q * t.topRows<2>();
+                    p[j] += t.row(2);
+                }
+                v0 = p[0];
+                u = p[1] - p[0];
+                v = p[2] - p[0];
+                lastTriangle = triangle;
+            }
+
+            coordinates[i] = v0 + barycentricSamplePositions(i, 1) * u + barycentricSamplePositions(i, 2) * v;
+        }
     }
 
     void ActiveAppearanceModel::setNumShapeModes(int numModes) {
-        std::cout << "shapeModes: " << shapeModes.rows() << "x" << shapeModes.cols() << std::endl;
-        std::cout << "shapeModeWeights: " << shapeModeWeights.rows() << "x" << shapeModeWeights.cols() << std::endl;
         int currNumModes = shapeModes.rows();
         shapeModes = MatrixX(shapeModes.block(currNumModes - numModes, 0, numModes, shapeModes.cols()));
         shapeModeWeights = MatrixX(shapeModeWeights.block(0, currNumModes - numModes, 1, numModes));
-        std::cout << "shapeModes: " << shapeModes.rows() << "x" << shapeModes.cols() << std::endl;
-        std::cout << "shapeModeWeights: " << shapeModeWeights.rows() << "x" << shapeModeWeights.cols() << std::endl;
     }
 
     void ActiveAppearanceModel::setNumAppearanceModes(int numModes) {
-        std::cout << "appearanceModes: " << appearanceModes.rows() << "x" << appearanceModes.cols() << std::endl;
-        std::cout << "appearanceModeWeights: " << appearanceModeWeights.rows() << "x" << appearanceModeWeights.cols() << std::endl;
         int currNumModes = appearanceModes.rows();
         appearanceModes = MatrixX(appearanceModes.block(currNumModes - numModes, 0, numModes, appearanceModes.cols()));
         appearanceModeWeights = MatrixX(appearanceModeWeights.block(0, currNumModes - numModes, 1, numModes));
-        std::cout << "appearanceModes: " << appearanceModes.rows() << "x" << appearanceModes.cols() << std::endl;
-        std::cout << "appearanceModeWeights: " << appearanceModeWeights.rows() << "x" << appearanceModeWeights.cols() << std::endl;
     }
 
 }
\ No newline at end of file
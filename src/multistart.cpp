@@ -0,0 +1,252 @@
+/**
+This file is part of Active Appearance Models (AAM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AAM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AAM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AAM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <aam/multistart.h>
+#include <aam/model.h>
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace aam {
+
+    /** Performs a number of matching steps on a range of hypotheses */
+    class StepHypotheses : public cv::ParallelLoopBody {
+    public:
+        StepHypotheses(std::vector<Matcher2>& hypotheses, int steps)
+            : _hypotheses(&hypotheses), _steps(steps)
+        {}
+
+        virtual void operator()(const cv::Range& range) const {
+            for (int i = range.start; i < range.end; ++i) {
+                Matcher2 &m = (*_hypotheses)[i];
+                for (int s = 0; s < _steps; ++s) {
+                    m.step();
+                }
+            }
+        }
+
+    private:
+        std::vector<Matcher2> *_hypotheses;
+        int _steps;
+    };
+
+    /** Measures the error of a range of hypotheses at their current parameters on all samples, so that 
+        hypotheses are ranked on the same basis whatever subsets they were fitted on. Diverged hypotheses 
+        rank last. */
+    class MeasureHypotheses : public cv::ParallelLoopBody {
+    public:
+        MeasureHypotheses(std::vector<Matcher2>& hypotheses, std::vector<Scalar>& errors)
+            : _hypotheses(&hypotheses), _errors(&errors)
+        {}
+
+        virtual void operator()(const cv::Range& range) const {
+            for (int i = range.start; i < range.end; ++i) {
+                Scalar e = (*_hypotheses)[i].measureCurrentError();
+                (*_errors)[i] = (e == e) ? e : std::numeric_limits<Scalar>::max();
+            }
+        }
+
+    private:
+        std::vector<Matcher2> *_hypotheses;
+        std::vector<Scalar> *_errors;
+    };
+
+    MultiStartMatcher::MultiStartMatcher(const ActiveAppearanceModel& model, Matcher2::Algorithm algorithm)
+        : _prototype(model, algorithm),
+          _coarsePrototype(_prototype),
+          _nSamples(model.barycentricSamplePositions.rows()),
+          _nShapeParams(model.shapeModeWeights.cols()),
+          _nAppearanceParams(model.appearanceModeWeights.cols()),
+          _initialized(false),
+          _region(0, 0, 640, 480),
+          _nx(4), _ny(3),
+          _scalings(1, Scalar(1)),
+          _coarseSteps(10),
+          _coarseSampleFraction(Scalar(0.25)),
+          _refineHypotheses(3),
+          _refineSteps(30),
+          _seed(std::mt19937::default_seed)
+    {}
+
+    void MultiStartMatcher::setPositionGrid(const cv::Rect& region, int nx, int ny) {
+        _region = region;
+        _nx = std::max(nx, 1);
+        _ny = std::max(ny, 1);
+    }
+
+    void MultiStartMatcher::setScalings(const std::vector<Scalar>& scalings) {
+        _scalings = scalings;
+        if (_scalings.empty())
+            _scalings.push_back(Scalar(1));
+    }
+
+    void MultiStartMatcher::setCoarseFitting(int steps, Scalar sampleFraction) {
+        _coarseSteps = steps;
+        _coarseSampleFraction = std::min(std::max(sampleFraction, Scalar(0)), Scalar(1));
+        _initialized = false;
+    }
+
+    void MultiStartMatcher::setRefinement(int hypotheses, int steps) {
+        _refineHypotheses = std::max(hypotheses, 1);
+        _refineSteps = steps;
+    }
+
+    void MultiStartMatcher::setSeed(unsigned int seed) {
+        _seed = seed;
+    }
+
+    Scalar MultiStartMatcher::fit(const cv::Mat& img, Affine2& pose, RowVectorX& shapeParams, RowVectorX& appearanceParams) {
+
+        RowVectorX initialShapeParams = RowVectorX::Zero(_nShapeParams);
+        RowVectorX initialAppearanceParams = RowVectorX::Zero(_nAppearanceParams);
+
+        if (!_initialized) {
+            // pre-compute model dependent entities only once, copies share them
+            if (!_prototype.init(img, 0, 0, 1, initialShapeParams, initialAppearanceParams))
+                return std::numeric_limits<Scalar>::quiet_NaN();
+
+            _coarsePrototype = _prototype;
+            if (_coarseSampleFraction < 1) {
+                int nSamples = std::max(1, (int)(_coarseSampleFraction * _nSamples));
+                _coarsePrototype.setSampleSubsets(Matcher2::STRATIFIED_RANDOM, nSamples, 4);
+            }
+
+            _initialized = true;
+        }
+
+        // one hypothesis per starting pose
+        std::vector<Matcher2> hypotheses;
+        hypotheses.reserve(_nx * _ny * _scalings.size());
+
+        const Scalar cellWidth = Scalar(_region.width) / _nx;
+        const Scalar cellHeight = Scalar(_region.height) / _ny;
+
+        for (int y = 0; y < _ny; ++y) {
+            for (int x = 0; x < _nx; ++x) {
+                for (size_t s = 0; s < _scalings.size(); ++s) {
+                    hypotheses.push_back(_coarsePrototype);
+                    Matcher2 &m = hypotheses.back();
+                    m.setSeed(_seed + (unsigned int)(hypotheses.size() - 1));
+                    m.setImage(img);
+                    m.reset(
+                        _region.x + (x + Scalar(0.5)) * cellWidth, 
+                        _region.y + (y + Scalar(0.5)) * cellHeight, 
+                        _scalings[s], 
+                        initialShapeParams, 
+                        initialAppearanceParams);
+                }
+            }
+        }
+
+        // coarse fitting of all hypotheses
+        cv::parallel_for_(cv::Range(0, (int)hypotheses.size()), StepHypotheses(hypotheses, _coarseSteps));
+
+        // keep only the best hypotheses
+        std::vector<Scalar> errors(hypotheses.size());
+        cv::parallel_for_(cv::Range(0, (int)hypotheses.size()), MeasureHypotheses(hypotheses, errors));
+
+        std::vector<int> order(hypotheses.size());
+        for (size_t i = 0; i < hypotheses.size(); ++i) {
+            order[i] = (int)i;
+        }
+
+        const int nKeep = std::min(_refineHypotheses, (int)hypotheses.size());
+        std::partial_sort(order.begin(), order.begin() + nKeep, order.end(), 
+            [&errors](int a, int b) { return errors[a] < errors[b]; });
+
+        std::vector<Matcher2> best;
+        best.reserve(nKeep);
+        for (int i = 0; i < nKeep; ++i) {
+            best.push_back(hypotheses[order[i]]);
+            best.back().useAllSamples();
+        }
+        hypotheses.clear();
+
+        // refinement on all samples
+        cv::parallel_for_(cv::Range(0, nKeep), StepHypotheses(best, _refineSteps));
+
+        errors.resize(nKeep);
+        cv::parallel_for_(cv::Range(0, nKeep), MeasureHypotheses(best, errors));
+
+        int bestIdx = 0;
+        for (int i = 1; i < nKeep; ++i) {
+            if (errors[i] < errors[bestIdx])
+                bestIdx = i;
+        }
+
+        Matcher2 &m = best[bestIdx];
+        pose = m.getCurrentGlobalTransform();
+        shapeParams = m.getCurrentShapeParams();
+        appearanceParams = m.getCurrentAppearanceParams();
+
+        return errors[bestIdx] < std::numeric_limits<Scalar>::max() ? errors[bestIdx] : std::numeric_limits<Scalar>::quiet_NaN();
+    }
+
+    MultiInstanceMatcher::MultiInstanceMatcher(const ActiveAppearanceModel& model, Matcher2::Algorithm algorithm)
+        : _prototype(model, algorithm),
+          _nShapeParams(model.shapeModeWeights.cols()),
+          _nAppearanceParams(model.appearanceModeWeights.cols()),
+          _initialized(false),
+          _steps(30)
+    {}
+
+    void MultiInstanceMatcher::setSteps(int steps) {
+        _steps = steps;
+    }
+
+    bool MultiInstanceMatcher::fit(const cv::Mat& img, const std::vector<Affine2>& poses, std::vector<InstanceFit>& results) {
+
+        RowVectorX initialShapeParams = RowVectorX::Zero(_nShapeParams);
+        RowVectorX initialAppearanceParams = RowVectorX::Zero(_nAppearanceParams);
+
+        // pre-compute model dependent entities only once, otherwise just rebind the image
+        if (!_initialized) {
+            if (!_prototype.init(img, 0, 0, 1, initialShapeParams, initialAppearanceParams)) {
+                results.clear();
+                return false;
+            }
+            _initialized = true;
+        } else {
+            _prototype.setImage(img);
+        }
+
+        // one copy per instance, sharing image binding and pre-computation
+        std::vector<Matcher2> instances(poses.size(), _prototype);
+        for (size_t i = 0; i < poses.size(); ++i) {
+            instances[i].setCurrentGlobalTransform(poses[i]);
+            instances[i].setCurrentShapeParams(initialShapeParams);
+            instances[i].setCurrentAppearanceParams(initialAppearanceParams);
+        }
+
+        cv::parallel_for_(cv::Range(0, (int)instances.size()), StepHypotheses(instances, _steps));
+
+        results.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); ++i) {
+            Matcher2 &m = instances[i];
+            results[i].pose = m.getCurrentGlobalTransform();
+            results[i].shapeParams = m.getCurrentShapeParams();
+            results[i].appearanceParams = m.getCurrentAppearanceParams();
+            results[i].error = m.getCurrentError();
+        }
+
+        return true;
+    }
+
+}
\ No newline at end of file
@@ -25,16 +25,23 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace aam {
 
-    void computePCA(Eigen::Ref<const MatrixX> data, RowVectorX &mean, MatrixX &basis, RowVectorX &weights)
+    template<class T>
+    void computePCA(
+        Eigen::Ref<const typename AamMatrixTraits<T>::MatrixType> data,
+        typename AamMatrixTraits<T, 1, Eigen::Dynamic>::MatrixType &mean,
+        typename AamMatrixTraits<T>::MatrixType &basis,
+        typename AamMatrixTraits<T, 1, Eigen::Dynamic>::MatrixType &weights)
     {
+        typedef typename AamMatrixTraits<T>::MatrixType MatrixT;
+
         mean = data.colwise().mean();
-        MatrixX centered = data.rowwise() - mean;
+        MatrixT centered = data.rowwise() - mean;
 
         if (data.rows() > data.cols()) {  // use regular Eigen-analysis
 
-            MatrixX cov = (centered.adjoint() * centered) * ((aam::Scalar)1.0 / (aam::Scalar)(data.rows() - 1));
+            MatrixT cov = (centered.adjoint() * centered) * ((T)1.0 / (T)(data.rows() - 1));
 
-            Eigen::SelfAdjointEigenSolver<MatrixX> eig(cov);
+            Eigen::SelfAdjointEigenSolver<MatrixT> eig(cov);
             basis = eig.eigenvectors().transpose();
             weights = eig.eigenvalues();
 
@@ -42,17 +49,33 @@ namespace aam {
                   // to reduce size of covariance matrix. Important: need to multiply by centered.transpose() and 
                   // apply normalization of eigenvectors afterwards!
 
-            MatrixX cov2 = (centered * centered.adjoint()) * ((aam::Scalar)1.0 / (aam::Scalar)(data.rows() - 1));
+            MatrixT cov2 = (centered * centered.adjoint()) * ((T)1.0 / (T)(data.rows() - 1));
 
-            Eigen::SelfAdjointEigenSolver<MatrixX> eig2(cov2);
-            MatrixX b = (centered.transpose() * eig2.eigenvectors()).transpose();
-            MatrixX n = b.rowwise().norm();
+            Eigen::SelfAdjointEigenSolver<MatrixT> eig2(cov2);
+            MatrixT b = (centered.transpose() * eig2.eigenvectors()).transpose();
             b.rowwise().normalize();    
             basis = b;
             weights = eig2.eigenvalues();
         }
     }
 
+    template void computePCA<float>(
+        Eigen::Ref<const AamMatrixTraits<float>::MatrixType>,
+        AamMatrixTraits<float, 1, Eigen::Dynamic>::MatrixType &,
+        AamMatrixTraits<float>::MatrixType &,
+        AamMatrixTraits<float, 1, Eigen::Dynamic>::MatrixType &);
+
+    template void computePCA<double>(
+        Eigen::Ref<const AamMatrixTraits<double>::MatrixType>,
+        AamMatrixTraits<double, 1, Eigen::Dynamic>::MatrixType &,
+        AamMatrixTraits<double>::MatrixType &,
+        AamMatrixTraits<double, 1, Eigen::Dynamic>::MatrixType &);
+
+    void computePCA(Eigen::Ref<const MatrixX> data, RowVectorX &mean, MatrixX &basis, RowVectorX &weights)
+    {
+        computePCA<Scalar>(data, mean, basis, weights);
+    }
+
     RowVectorX::Index computePCADimensionality(Eigen::Ref<const RowVectorX> weights, MatrixX::Scalar toleratedCompressionLoss) {
         RowVectorX::Scalar sum = weights.sum();
         RowVectorX::Scalar loss = 0.f;
@@ -27,34 +27,41 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace aam {
     
-    Scalar procrustes(Eigen::Ref<const RowVectorX> X_, Eigen::Ref<RowVectorX> Y_)
+    template<class T>
+    T procrustes(
+        Eigen::Ref<const typename AamMatrixTraits<T, 1, Eigen::Dynamic>::MatrixType> X_,
+        Eigen::Ref<typename AamMatrixTraits<T, 1, Eigen::Dynamic>::MatrixType> Y_)
     {
-        auto X = toSeparatedViewConst<Scalar>(X_);
-        auto Y = toSeparatedView<Scalar>(Y_);
+        typedef typename AamMatrixTraits<T>::MatrixType MatrixT;
+        typedef typename AamMatrixTraits<T, 2, 2>::MatrixType Matrix2T;
+        typedef typename AamMatrixTraits<T, 1, 2>::MatrixType RowVector2T;
 
-        RowVector2 meanX = X.colwise().mean();
-        RowVector2 meanY = Y.colwise().mean();
+        auto X = toSeparatedViewConst<T>(X_);
+        auto Y = toSeparatedView<T>(Y_);
 
-        MatrixX centeredX = X.rowwise() - meanX;
-        MatrixX centeredY = Y.rowwise() - meanY;
+        RowVector2T meanX = X.colwise().mean();
+        RowVector2T meanY = Y.colwise().mean();
+
+        MatrixT centeredX = X.rowwise() - meanX;
+        MatrixT centeredY = Y.rowwise() - meanY;
 
         // Compute Frobenius norm. 
-        const Scalar sX = centeredX.norm();
-        const Scalar sY = centeredY.norm();
+        const T sX = centeredX.norm();
+        const T sY = centeredY.norm();
 
         // Scale to unit norm
         centeredX /= sX;
         centeredY /= sY;
 
         // Find optimal rotation based on correlation of landmarks
-        MatrixX A = centeredX.transpose() * centeredY;
+        MatrixT A = centeredX.transpose() * centeredY;
         auto svd = A.jacobiSvd(Eigen::ComputeThinU | Eigen::ComputeThinV);
 
         // Equation 7.
-        Matrix2 v = svd.matrixV();
-        Matrix2 u = svd.matrixU();
-        RowVector2 s = svd.singularValues();
-        Matrix2 rot = v * u.transpose();
+        Matrix2T v = svd.matrixV();
+        Matrix2T u = svd.matrixU();
+        RowVector2T s = svd.singularValues();
+        Matrix2T rot = v * u.transpose();
 
         // Make sure we don't suffer from reflection.
         if (rot.determinant() < 0) {
@@ -63,13 +70,13 @@ namespace aam {
             rot = v * u.transpose();
         }
 
-        Scalar trace = s.sum();
+        T trace = s.sum();
 
         // Scaling of Y
-        // Scalar b = trace * sX / sY;
+        // T b = trace * sX / sY;
 
         // Distance of X and T(Y)
-        Scalar d = 1 - trace * trace;
+        T d = 1 - trace * trace;
 
         // Transform Y
         Y = (((centeredY * rot) * trace * sX).rowwise() + meanX).eval();
@@ -77,11 +84,16 @@ namespace aam {
         return d;
     }
 
-    MatrixX generalizedProcrustes(Eigen::Ref<const MatrixX> X, int maxIterations)
+    template<class T>
+    typename AamMatrixTraits<T>::MatrixType generalizedProcrustes(
+        Eigen::Ref<const typename AamMatrixTraits<T>::MatrixType> X, int maxIterations)
     {        
-        const MatrixX::Index nShapes = X.rows();
+        typedef typename AamMatrixTraits<T>::MatrixType MatrixT;
+        typedef typename AamMatrixTraits<T, 1, Eigen::Dynamic>::MatrixType RowVectorT;
 
-        MatrixX alignedShapes = X;
+        const typename MatrixT::Index nShapes = X.rows();
+
+        MatrixT alignedShapes = X;
         
         // Perform iterative optimization
         // - arbitrarily choose a reference shape(typically by selecting it among the available instances)
@@ -90,21 +102,21 @@ namespace aam {
         // - if the Procrustes distance between mean and reference shape is above a threshold, set reference to mean shape and continue to step 2.
         
         bool done = false;
-        RowVectorX refShape = alignedShapes.row(0);
-        Scalar lastDist = std::numeric_limits<Scalar>::max();
+        RowVectorT refShape = alignedShapes.row(0);
+        T lastDist = std::numeric_limits<T>::max();
         int iterations = 0;
         do {
-            for (MatrixX::Index s = 0; s < nShapes; ++s) {
-                procrustes(refShape, alignedShapes.row(s));
+            for (typename MatrixT::Index s = 0; s < nShapes; ++s) {
+                procrustes<T>(refShape, alignedShapes.row(s));
             }
 
-            RowVectorX meanShape = RowVectorX::Zero(X.cols());
-            for (MatrixX::Index s = 0; s < nShapes; ++s) {
+            RowVectorT meanShape = RowVectorT::Zero(X.cols());
+            for (typename MatrixT::Index s = 0; s < nShapes; ++s) {
                 meanShape += alignedShapes.row(s);
             }
-            meanShape /= (Scalar)nShapes;
+            meanShape /= (T)nShapes;
 
-            Scalar dist = (meanShape - refShape).norm();
+            T dist = (meanShape - refShape).norm();
             if (dist > lastDist || ++iterations > maxIterations)
                 done = true;
 
@@ -116,4 +128,28 @@ namespace aam {
 
         return alignedShapes;
     }
+
+    template float procrustes<float>(
+        Eigen::Ref<const AamMatrixTraits<float, 1, Eigen::Dynamic>::MatrixType>,
+        Eigen::Ref<AamMatrixTraits<float, 1, Eigen::Dynamic>::MatrixType>);
+
+    template double procrustes<double>(
+        Eigen::Ref<const AamMatrixTraits<double, 1, Eigen::Dynamic>::MatrixType>,
+        Eigen::Ref<AamMatrixTraits<double, 1, Eigen::Dynamic>::MatrixType>);
+
+    template AamMatrixTraits<float>::MatrixType generalizedProcrustes<float>(
+        Eigen::Ref<const AamMatrixTraits<float>::MatrixType>, int);
+
+    template AamMatrixTraits<double>::MatrixType generalizedProcrustes<double>(
+        Eigen::Ref<const AamMatrixTraits<double>::MatrixType>, int);
+
+    Scalar procrustes(Eigen::Ref<const RowVectorX> X, Eigen::Ref<RowVectorX> Y)
+    {
+        return procrustes<Scalar>(X, Y);
+    }
+
+    MatrixX generalizedProcrustes(Eigen::Ref<const MatrixX> X, int maxIterations)
+    {
+        return generalizedProcrustes<Scalar>(X, maxIterations);
+    }
 }
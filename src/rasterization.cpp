@@ -26,10 +26,88 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #include <aam/bilinear.h>
 #include <opencv2/opencv.hpp>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 namespace aam {
 
 
+    /** Number of pixel rows per tile of the rasterizer */
+    const MatrixX::Index rasterTileRows = 32;
+
+    /** Rasterizes the triangles binned to tiles of rows.
+
+        Runs in two passes. Without output the number of samples per triangle and tile 
+        is counted. With output the samples are written to the rows starting at the 
+        given offsets per triangle and tile. */
+    class RasterizeTiles : public cv::ParallelLoopBody {
+    public:
+        RasterizeTiles(
+            const Eigen::Ref<const RowVectorX>& shape,
+            const Eigen::Ref<const RowVectorXi>& triangleIds,
+            const std::vector<MatrixX::Index>& binStarts,
+            const std::vector<MatrixX::Index>& binTriangles,
+            const Eigen::Matrix<MatrixX::Index, Eigen::Dynamic, 4, Eigen::RowMajor>& triangleBounds,
+            MatrixX::Index yBegin,
+            std::vector<MatrixX::Index>& counts,
+            MatrixX *result)
+            : _shape(shape), _triangleIds(triangleIds), _binStarts(binStarts), _binTriangles(binTriangles),
+              _triangleBounds(triangleBounds), _yBegin(yBegin), _counts(&counts), _result(result)
+        {}
+
+        virtual void operator()(const cv::Range& range) const {
+            const MatrixX::Index nTiles = (MatrixX::Index)_binStarts.size() - 1;
+            ParametrizedTriangle pt;
+
+            for (int tile = range.start; tile < range.end; ++tile) {
+                const MatrixX::Index tileBegin = _yBegin + tile * rasterTileRows;
+                const MatrixX::Index tileEnd = tileBegin + rasterTileRows;
+
+                for (MatrixX::Index k = _binStarts[tile]; k < _binStarts[tile + 1]; ++k) {
+                    const MatrixX::Index tri = _binTriangles[k];
+                    pt.updateVertices(
+                        _shape.segment(2 * _triangleIds(tri * 3 + 0), 2),
+                        _shape.segment(2 * _triangleIds(tri * 3 + 1), 2),
+                        _shape.segment(2 * _triangleIds(tri * 3 + 2), 2));
+
+                    const MatrixX::Index y0 = std::max(tileBegin, _triangleBounds(tri, 2));
+                    const MatrixX::Index y1 = std::min(tileEnd, _triangleBounds(tri, 3));
+
+                    MatrixX::Index &count = (*_counts)[tri * nTiles + tile];
+                    MatrixX::Index row = count;
+
+                    for (MatrixX::Index y = y0; y < y1; ++y) {
+                        for (MatrixX::Index x = _triangleBounds(tri, 0); x < _triangleBounds(tri, 1); ++x) {
+                            RowVector2 p((x + Scalar(0.5)), (y + Scalar(0.5)));
+                            RowVector2 bary = pt.baryAt(p);
+
+                            if (pt.isBaryInside(bary)) {
+                                if (_result) {
+                                    _result->row(row) = RowVector3(Scalar(tri), bary(0), bary(1));
+                                }
+                                ++row;
+                            }
+                        }
+                    }
+
+                    if (!_result) {
+                        count = row;
+                    }
+                }
+            }
+        }
+
+    private:
+        const Eigen::Ref<const RowVectorX>& _shape;
+        const Eigen::Ref<const RowVectorXi>& _triangleIds;
+        const std::vector<MatrixX::Index>& _binStarts;
+        const std::vector<MatrixX::Index>& _binTriangles;
+        const Eigen::Matrix<MatrixX::Index, Eigen::Dynamic, 4, Eigen::RowMajor>& _triangleBounds;
+        MatrixX::Index _yBegin;
+        std::vector<MatrixX::Index> *_counts;
+        MatrixX *_result;
+    };
+
     MatrixX rasterizeShape(
         Eigen::Ref<const RowVectorX> pointsInterleaved,
         Eigen::Ref<const RowVectorXi> triangleIds,
@@ -38,7 +116,9 @@ namespace aam {
         auto points = toSeparatedViewConst<Scalar>(pointsInterleaved);
         MatrixX::Index nTriangles = triangleIds.size() / 3;
 
-        std::vector<RowVector3> coords;
+        if (nTriangles == 0) {
+            return MatrixX(0, 3);
+        }
 
         aam::Scalar minX = points.row(triangleIds(0)).x();
         aam::Scalar maxX = points.row(triangleIds(0)).x();
@@ -52,35 +132,306 @@ namespace aam {
             maxY = std::max(p.y(), maxY);
         }
 
+        const MatrixX::Index xBegin = (MatrixX::Index)minX;
+        const MatrixX::Index xEnd = (MatrixX::Index)(maxX + 1);
+        const MatrixX::Index yBegin = (MatrixX::Index)minY;
+        const MatrixX::Index yEnd = (MatrixX::Index)(maxY + 1);
+
+        if (yEnd <= yBegin || xEnd <= xBegin) {
+            return MatrixX(0, 3);
+        }
+
+        // Pixel range per triangle: xBegin, xEnd, yBegin, yEnd. Grown by one pixel so that 
+        // pixel centers on the bounding box are tested as well.
+        Eigen::Matrix<MatrixX::Index, Eigen::Dynamic, 4, Eigen::RowMajor> triangleBounds(nTriangles, 4);
         for (MatrixX::Index tri = 0; tri < nTriangles; ++tri) {
             auto p0 = points.row(triangleIds(tri * 3 + 0));
             auto p1 = points.row(triangleIds(tri * 3 + 1));
             auto p2 = points.row(triangleIds(tri * 3 + 2));
 
-            ParametrizedTriangle pt(p0, p1, p2);
+            triangleBounds(tri, 0) = std::max(xBegin, (MatrixX::Index)std::floor(std::min(p0.x(), std::min(p1.x(), p2.x()))) - 1);
+            triangleBounds(tri, 1) = std::min(xEnd, (MatrixX::Index)std::floor(std::max(p0.x(), std::max(p1.x(), p2.x()))) + 2);
+            triangleBounds(tri, 2) = std::max(yBegin, (MatrixX::Index)std::floor(std::min(p0.y(), std::min(p1.y(), p2.y()))) - 1);
+            triangleBounds(tri, 3) = std::min(yEnd, (MatrixX::Index)std::floor(std::max(p0.y(), std::max(p1.y(), p2.y()))) + 2);
+        }
 
-            for (MatrixX::Index y = (MatrixX::Index)minY; y < (MatrixX::Index)(maxY+1); ++y) {
-                for (MatrixX::Index x = (MatrixX::Index)minX; x < (MatrixX::Index)(maxX+1); ++x) {
-                    RowVector2 p((x + Scalar(0.5)), (y + Scalar(0.5)));
-                    RowVector2 bary = pt.baryAt(p);
+        // Bin triangles to tiles of rows, keeping triangle order within each tile.
+        const MatrixX::Index nTiles = (yEnd - yBegin + rasterTileRows - 1) / rasterTileRows;
+        std::vector<MatrixX::Index> binStarts(nTiles + 1, 0);
+        for (MatrixX::Index tri = 0; tri < nTriangles; ++tri) {
+            if (triangleBounds(tri, 2) >= triangleBounds(tri, 3) || triangleBounds(tri, 0) >= triangleBounds(tri, 1)) {
+                continue;
+            }
+            for (MatrixX::Index t = (triangleBounds(tri, 2) - yBegin) / rasterTileRows; t <= (triangleBounds(tri, 3) - 1 - yBegin) / rasterTileRows; ++t) {
+                ++binStarts[t + 1];
+            }
+        }
+        for (MatrixX::Index t = 0; t < nTiles; ++t) {
+            binStarts[t + 1] += binStarts[t];
+        }
 
-                    if (pt.isBaryInside(bary)) {
-                        coords.push_back(RowVector3(aam::Scalar(tri), bary(0), bary(1)));
-                    }
-                }
+        std::vector<MatrixX::Index> binTriangles(binStarts[nTiles]);
+        std::vector<MatrixX::Index> next(binStarts.begin(), binStarts.end() - 1);
+        for (MatrixX::Index tri = 0; tri < nTriangles; ++tri) {
+            if (triangleBounds(tri, 2) >= triangleBounds(tri, 3) || triangleBounds(tri, 0) >= triangleBounds(tri, 1)) {
+                continue;
+            }
+            for (MatrixX::Index t = (triangleBounds(tri, 2) - yBegin) / rasterTileRows; t <= (triangleBounds(tri, 3) - 1 - yBegin) / rasterTileRows; ++t) {
+                binTriangles[next[t]++] = tri;
             }
         }
 
-        MatrixX result(coords.size(), 3);
+        // First pass counts samples per triangle and tile.
+        std::vector<MatrixX::Index> counts(nTriangles * nTiles, 0);
+        cv::parallel_for_(
+            cv::Range(0, (int)nTiles), 
+            RasterizeTiles(pointsInterleaved, triangleIds, binStarts, binTriangles, triangleBounds, yBegin, counts, 0));
 
-        for (size_t i = 0; i < coords.size(); ++i) {
-            result.row(i) = coords[i];
+        // Exclusive prefix sum in triangle-major order yields the output rows, such that 
+        // samples are ordered by triangle, row and column.
+        MatrixX::Index nSamples = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            MatrixX::Index c = counts[i];
+            counts[i] = nSamples;
+            nSamples += c;
         }
-        
+
+        // Second pass writes samples.
+        MatrixX result(nSamples, 3);
+        cv::parallel_for_(
+            cv::Range(0, (int)nTiles), 
+            RasterizeTiles(pointsInterleaved, triangleIds, binStarts, binTriangles, triangleBounds, yBegin, counts, &result));
+
         return result;
-        
     }
     
+    /** Find runs of consecutive samples sharing a triangle. Stores the first sample of each run followed by 
+        the number of samples. */
+    void findTriangleRuns(Eigen::Ref<const MatrixX> barycentricSamplePositions, std::vector<MatrixX::Index>& runs)
+    {
+        runs.clear();
+        int triIdLast = -1;
+        for (MatrixX::Index i = 0; i < barycentricSamplePositions.rows(); ++i) {
+            int triId = (int)barycentricSamplePositions(i, 0);
+            if (i == 0 || triId != triIdLast) {
+                runs.push_back(i);
+                triIdLast = triId;
+            }
+        }
+        runs.push_back(barycentricSamplePositions.rows());
+    }
+
+    /** Base of loop bodies iterating over runs of samples sharing a triangle */
+    class TriangleRunsBody : public cv::ParallelLoopBody {
+    public:
+        TriangleRunsBody(
+            const Eigen::Ref<const RowVectorX>& shape,
+            const Eigen::Ref<const RowVectorXi>& triangleIds,
+            const Eigen::Ref<const MatrixX>& barycentricSamplePositions,
+            const std::vector<MatrixX::Index>& runs)
+            : _shape(shape), _triangleIds(triangleIds), _bary(barycentricSamplePositions), _runs(runs)
+        {}
+
+    protected:
+        /** Set up the triangle of the given run */
+        void updateTriangle(size_t run, ParametrizedTriangle& pt) const {
+            int triId = (int)_bary(_runs[run], 0);
+            pt.updateVertices(
+                _shape.segment(2 * _triangleIds(triId * 3 + 0), 2),
+                _shape.segment(2 * _triangleIds(triId * 3 + 1), 2),
+                _shape.segment(2 * _triangleIds(triId * 3 + 2), 2));
+        }
+
+        const Eigen::Ref<const RowVectorX>& _shape;
+        const Eigen::Ref<const RowVectorXi>& _triangleIds;
+        const Eigen::Ref<const MatrixX>& _bary;
+        const std::vector<MatrixX::Index>& _runs;
+    };
+
+    /** Computes the linear pixel index each sample is written to, -1 for samples outside of the image */
+    class LocateSamples : public TriangleRunsBody {
+    public:
+        LocateSamples(
+            const Eigen::Ref<const RowVectorX>& shape,
+            const Eigen::Ref<const RowVectorXi>& triangleIds,
+            const Eigen::Ref<const MatrixX>& barycentricSamplePositions,
+            const std::vector<MatrixX::Index>& runs,
+            int cols, int rows,
+            std::vector<int>& pixels)
+            : TriangleRunsBody(shape, triangleIds, barycentricSamplePositions, runs), _cols(cols), _rows(rows), _pixels(&pixels)
+        {}
+
+        virtual void operator()(const cv::Range& range) const {
+            ParametrizedTriangle pt;
+            for (int r = range.start; r < range.end; ++r) {
+                updateTriangle(r, pt);
+                for (MatrixX::Index i = _runs[r]; i < _runs[r + 1]; ++i) {
+                    auto p = pt.pointAt(_bary.row(i).rightCols(2));
+                    auto pi = (p - RowVector2::Constant(Scalar(0.5))).cast<MatrixX::Index>();
+
+                    if ((pi.array() >= 0).all() && pi(0) < _cols && pi(1) < _rows) {
+                        (*_pixels)[i] = (int)(pi(1) * _cols + pi(0));
+                    } else {
+                        (*_pixels)[i] = -1;
+                    }
+                }
+            }
+        }
+
+    private:
+        int _cols, _rows;
+        std::vector<int> *_pixels;
+    };
+
+    /** Writes colors of samples grouped by bands of rows of type T with cn channels */
+    template<class T, int cn>
+    class WriteBands : public cv::ParallelLoopBody {
+    public:
+        WriteBands(const cv::Mat& colors, cv::Mat& dst, const std::vector<int>& pixels, const std::vector<int>& order, const std::vector<int>& bandStarts)
+            : _colors(colors), _dst(dst), _pixels(pixels), _order(order), _bandStarts(bandStarts)
+        {}
+
+        virtual void operator()(const cv::Range& range) const {
+            for (int b = range.start; b < range.end; ++b) {
+                for (int k = _bandStarts[b]; k < _bandStarts[b + 1]; ++k) {
+                    const int i = _order[k];
+                    const int y = _pixels[i] / _dst.cols;
+                    const int x = _pixels[i] - y * _dst.cols;
+
+                    const T *src = _colors.ptr<T>(i);
+                    T *d = _dst.ptr<T>(y) + x * cn;
+                    for (int c = 0; c < cn; ++c) {
+                        d[c] = src[c];
+                    }
+                }
+            }
+        }
+
+    private:
+        const cv::Mat &_colors;
+        cv::Mat &_dst;
+        const std::vector<int> &_pixels;
+        const std::vector<int> &_order;
+        const std::vector<int> &_bandStarts;
+    };
+
+    /** Write colors of sample positions to pixels of type T with cn channels using row pointers.
+
+        Samples are located in parallel per triangle run. Neighboring triangles may cover the same pixel, 
+        so pixels are then written in parallel per band of rows, each band in sample order. The result 
+        is identical to a sequential pass in which later samples overwrite earlier ones. */
+    template<class T, int cn>
+    void writeShapeImageTyped(
+        Eigen::Ref<const RowVectorX> shape,
+        Eigen::Ref<const RowVectorXi> triangleIds,
+        Eigen::Ref<const MatrixX> barycentricSamplePositions,
+        const cv::Mat& colors,
+        cv::Mat& dst)
+    {
+        const int nSamples = (int)barycentricSamplePositions.rows();
+        if (nSamples == 0 || dst.empty()) {
+            return;
+        }
+
+        std::vector<MatrixX::Index> runs;
+        findTriangleRuns(barycentricSamplePositions, runs);
+
+        std::vector<int> pixels(nSamples);
+        cv::parallel_for_(
+            cv::Range(0, (int)runs.size() - 1), 
+            LocateSamples(shape, triangleIds, barycentricSamplePositions, runs, dst.cols, dst.rows, pixels));
+
+        // group samples by band of rows, keeping sample order within each band
+        const int nBands = std::min(dst.rows, 4 * std::max(1, cv::getNumThreads()));
+        std::vector<int> bandStarts(nBands + 1, 0);
+        for (int i = 0; i < nSamples; ++i) {
+            if (pixels[i] >= 0) {
+                ++bandStarts[(pixels[i] / dst.cols) * nBands / dst.rows + 1];
+            }
+        }
+        for (int b = 0; b < nBands; ++b) {
+            bandStarts[b + 1] += bandStarts[b];
+        }
+
+        std::vector<int> order(bandStarts[nBands]);
+        std::vector<int> next(bandStarts.begin(), bandStarts.end() - 1);
+        for (int i = 0; i < nSamples; ++i) {
+            if (pixels[i] >= 0) {
+                order[next[(pixels[i] / dst.cols) * nBands / dst.rows]++] = i;
+            }
+        }
+
+        cv::parallel_for_(cv::Range(0, nBands), WriteBands<T, cn>(colors, dst, pixels, order, bandStarts));
+    }
+
+    /** Reads bilinearly interpolated colors at sample positions from pixels of type T with cn channels */
+    template<class T, int cn>
+    class ReadTriangleRuns : public TriangleRunsBody {
+    public:
+        ReadTriangleRuns(
+            const Eigen::Ref<const RowVectorX>& shape,
+            const Eigen::Ref<const RowVectorXi>& triangleIds,
+            const Eigen::Ref<const MatrixX>& barycentricSamplePositions,
+            const std::vector<MatrixX::Index>& runs,
+            const cv::Mat& img,
+            cv::Mat& dst)
+            : TriangleRunsBody(shape, triangleIds, barycentricSamplePositions, runs), _img(img), _dst(dst)
+        {}
+
+        virtual void operator()(const cv::Range& range) const {
+            ParametrizedTriangle pt;
+            for (int r = range.start; r < range.end; ++r) {
+                updateTriangle(r, pt);
+                for (MatrixX::Index i = _runs[r]; i < _runs[r + 1]; ++i) {
+                    auto p = pt.pointAt(_bary.row(i).rightCols(2));
+
+                    // same interpolation and border handling as aam::bilinear
+                    const Scalar x = p(0) - Scalar(0.5);
+                    const Scalar y = p(1) - Scalar(0.5);
+                    const int ix = static_cast<int>(std::floor(x));
+                    const int iy = static_cast<int>(std::floor(y));
+
+                    const int x0 = cv::borderInterpolate(ix, _img.cols, cv::BORDER_REFLECT_101) * cn;
+                    const int x1 = cv::borderInterpolate(ix + 1, _img.cols, cv::BORDER_REFLECT_101) * cn;
+                    const T *r0 = _img.ptr<T>(cv::borderInterpolate(iy, _img.rows, cv::BORDER_REFLECT_101));
+                    const T *r1 = _img.ptr<T>(cv::borderInterpolate(iy + 1, _img.rows, cv::BORDER_REFLECT_101));
+
+                    const Scalar a = x - (Scalar)ix;
+                    const Scalar b = y - (Scalar)iy;
+
+                    T *d = _dst.ptr<T>((int)i);
+                    for (int c = 0; c < cn; ++c) {
+                        const Scalar top = r0[x0 + c] * (Scalar(1) - a) + r0[x1 + c] * a;
+                        const Scalar bottom = r1[x0 + c] * (Scalar(1) - a) + r1[x1 + c] * a;
+                        d[c] = cv::saturate_cast<T>(top * (Scalar(1) - b) + bottom * b);
+                    }
+                }
+            }
+        }
+
+    private:
+        const cv::Mat &_img;
+        cv::Mat &_dst;
+    };
+
+    /** Read bilinearly interpolated colors at sample positions from pixels of type T with cn channels using 
+        row pointers. Each sample is read independently, triangle runs are processed in parallel. */
+    template<class T, int cn>
+    void readShapeImageTyped(
+        Eigen::Ref<const RowVectorX> shape,
+        Eigen::Ref<const RowVectorXi> triangleIds,
+        Eigen::Ref<const MatrixX> barycentricSamplePositions,
+        const cv::Mat& img,
+        cv::Mat& dst)
+    {
+        std::vector<MatrixX::Index> runs;
+        findTriangleRuns(barycentricSamplePositions, runs);
+
+        cv::parallel_for_(
+            cv::Range(0, (int)runs.size() - 1), 
+            ReadTriangleRuns<T, cn>(shape, triangleIds, barycentricSamplePositions, runs, img, dst));
+    }
+
     void writeShapeImage(
         Eigen::Ref<const RowVectorX> shape,
         Eigen::Ref<const RowVectorXi> triangleIds,
@@ -90,7 +441,26 @@ namespace aam {
     {
         cv::Mat colors = colorsAtSamplePositions_.getMat();
         cv::Mat dst = dst_.getMat();
+
+        // common pixel types, dispatched once per call
+        if (colors.type() == dst.type()) {
+            switch (dst.type()) {
+            case CV_8UC1:
+                writeShapeImageTyped<uchar, 1>(shape, triangleIds, barycentricSamplePositions, colors, dst);
+                return;
+            case CV_8UC3:
+                writeShapeImageTyped<uchar, 3>(shape, triangleIds, barycentricSamplePositions, colors, dst);
+                return;
+            case CV_32FC1:
+                writeShapeImageTyped<float, 1>(shape, triangleIds, barycentricSamplePositions, colors, dst);
+                return;
+            case CV_32FC3:
+                writeShapeImageTyped<float, 3>(shape, triangleIds, barycentricSamplePositions, colors, dst);
+                return;
+            }
+        }
         
+        // Other types are converted per pixel
         IplImage colorsipl = colors;
         IplImage dstipl = dst;
         
@@ -130,7 +500,24 @@ namespace aam {
 
         cv::Mat dst = dst_.getMat();
         cv::Mat img = img_.getMat();
+
+        // common pixel types, dispatched once per call
+        switch (img.type()) {
+        case CV_8UC1:
+            readShapeImageTyped<uchar, 1>(shape, triangleIds, barycentricSamplePositions, img, dst);
+            return;
+        case CV_8UC3:
+            readShapeImageTyped<uchar, 3>(shape, triangleIds, barycentricSamplePositions, img, dst);
+            return;
+        case CV_32FC1:
+            readShapeImageTyped<float, 1>(shape, triangleIds, barycentricSamplePositions, img, dst);
+            return;
+        case CV_32FC3:
+            readShapeImageTyped<float, 3>(shape, triangleIds, barycentricSamplePositions, img, dst);
+            return;
+        }
         
+        // Other types are converted per sample
         IplImage dstipl = dst;
 
         int triIdLast = -1;
@@ -182,5 +569,101 @@ namespace aam {
             cartesianPoints.push_back(p);
         }
     }
+
+    /** Sobel derivatives are accumulated in TrainingScalar and cast once to the scalar type of the gradient. */
+    template<class M>
+    void computeShapeImageGradientT(
+        Eigen::Ref<const RowVectorX> shape,
+        Eigen::Ref<const RowVectorXi> triangleIds,
+        Eigen::Ref<const MatrixX> barycentricSamplePositions,
+        Eigen::Ref<const RowVectorX> values,
+        M &gradient)
+    {
+        typedef typename M::Scalar T;
+
+        std::vector<RowVector2> coords;
+        barycentricToCartesian(shape, triangleIds, barycentricSamplePositions, coords);
+
+        const int nSamples = (int)coords.size();
+        const int nChannels = nSamples > 0 ? (int)(values.size() / nSamples) : 1;
+        gradient.setZero(nSamples * nChannels, 2);
+
+        if (nSamples == 0)
+            return;
+
+        // Pixel per sample (samples are located on pixel centers)
+        std::vector<int> px(nSamples), py(nSamples);
+        for (int i = 0; i < nSamples; ++i) {
+            px[i] = (int)std::floor(coords[i].x());
+            py[i] = (int)std::floor(coords[i].y());
+        }
+
+        const int minX = *std::min_element(px.begin(), px.end());
+        const int maxX = *std::max_element(px.begin(), px.end());
+        const int minY = *std::min_element(py.begin(), py.end());
+        const int maxY = *std::max_element(py.begin(), py.end());
+
+        // Lookup from pixel to sample index with a one pixel border, -1 where no sample exists.
+        // Samples on shared triangle edges occur more than once, the first one is used.
+        const int w = maxX - minX + 3;
+        const int h = maxY - minY + 3;
+        std::vector<int> lookup(w * h, -1);
+        for (int i = 0; i < nSamples; ++i) {
+            int &l = lookup[(py[i] - minY + 1) * w + (px[i] - minX + 1)];
+            if (l < 0)
+                l = i;
+        }
+
+        for (int i = 0; i < nSamples; ++i) {
+            const int center = (py[i] - minY + 1) * w + (px[i] - minX + 1);
+
+            // neighborhood is shared by all channels
+            int n[3][3];
+            bool complete = true;
+            for (int dy = -1; dy <= 1 && complete; ++dy) {
+                for (int dx = -1; dx <= 1 && complete; ++dx) {
+                    n[dy + 1][dx + 1] = lookup[center + dy * w + dx];
+                    complete = n[dy + 1][dx + 1] >= 0;
+                }
+            }
+
+            if (!complete)
+                continue;
+
+            for (int c = 0; c < nChannels; ++c) {
+                TrainingScalar v[3][3];
+                for (int dy = 0; dy < 3; ++dy) {
+                    for (int dx = 0; dx < 3; ++dx) {
+                        v[dy][dx] = values(n[dy][dx] * nChannels + c);
+                    }
+                }
+
+                gradient(i * nChannels + c, 0) = T(((v[0][2] + 2 * v[1][2] + v[2][2]) - (v[0][0] + 2 * v[1][0] + v[2][0])) * TrainingScalar(0.125));
+                gradient(i * nChannels + c, 1) = T(((v[2][0] + 2 * v[2][1] + v[2][2]) - (v[0][0] + 2 * v[0][1] + v[0][2])) * TrainingScalar(0.125));
+            }
+        }
+    }
+
+    void computeShapeImageGradient(
+        Eigen::Ref<const RowVectorX> shape,
+        Eigen::Ref<const RowVectorXi> triangleIds,
+        Eigen::Ref<const MatrixX> barycentricSamplePositions,
+        Eigen::Ref<const RowVectorX> values,
+        MatrixX &gradient)
+    {
+        computeShapeImageGradientT(shape, triangleIds, barycentricSamplePositions, values, gradient);
+    }
+
+#ifndef AAM_DOUBLE_PRECISION
+    void computeShapeImageGradient(
+        Eigen::Ref<const RowVectorX> shape,
+        Eigen::Ref<const RowVectorXi> triangleIds,
+        Eigen::Ref<const MatrixX> barycentricSamplePositions,
+        Eigen::Ref<const RowVectorX> values,
+        TrainingMatrixX &gradient)
+    {
+        computeShapeImageGradientT(shape, triangleIds, barycentricSamplePositions, values, gradient);
+    }
+#endif
     
 }
\ No newline at end of file
@@ -0,0 +1,305 @@
+/**
+This file is part of Active Appearance Models (AAM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AAM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AAM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AAM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <aam/search.h>
+#include <aam/rasterization.h>
+#include <aam/transform.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace aam {
+
+    /** Candidate tracked through the image pyramid */
+    struct SearchCandidate {
+        /** index of scaling and rotation */
+        size_t scaling, rotation;
+
+        /** pixel position of the origin of normalized shape coordinates at the current level */
+        cv::Point2f center;
+
+        /** normalized cross correlation */
+        Scalar score;
+    };
+
+    inline bool byDecreasingScore(const SearchCandidate& a, const SearchCandidate& b) {
+        return a.score > b.score;
+    }
+
+    GlobalPoseSearch::GlobalPoseSearch(const ActiveAppearanceModel& model)
+        : _shapeTransform(model.shapeTransformToTrainingData),
+          _scalings(1, Scalar(1)),
+          _rotations(1, Scalar(0)),
+          _levels(2),
+          _maxCandidates(5)
+    {
+        // Render the mean appearance in training data coordinates, cropped to the mean shape
+        RowVectorX s0 = transformShape(model.shapeTransformToTrainingData, model.shapeMean);
+        std::vector<RowVector2> positions;
+        barycentricToCartesian(s0, model.triangleIndices, model.barycentricSamplePositions, positions);
+
+        Eigen::Map<MatrixX> points(s0.data(), s0.cols() / 2, 2);
+        RowVector2 minC = points.colwise().minCoeff();
+        RowVector2 maxC = points.colwise().maxCoeff();
+
+        const int offx = (int)std::floor(minC(0));
+        const int offy = (int)std::floor(minC(1));
+        const int cols = (int)std::ceil(maxC(0)) - offx + 1;
+        const int rows = (int)std::ceil(maxC(1)) - offy + 1;
+
+        _meanAppearance.create(rows, cols, CV_32FC1);
+        _meanAppearance.setTo(0);
+        _meanMask.create(rows, cols, CV_8UC1);
+        _meanMask.setTo(0);
+
+        // templates are matched against gray images, channels of color models are averaged
+        const int nChannels = model.appearanceChannels();
+        for (size_t i = 0; i < positions.size(); ++i) {
+            const int x = (int)std::floor(positions[i](0)) - offx;
+            const int y = (int)std::floor(positions[i](1)) - offy;
+            if (x >= 0 && y >= 0 && x < cols && y < rows) {
+                _meanAppearance.at<float>(y, x) = (float)model.appearanceMean.segment(i * nChannels, nChannels).mean();
+                _meanMask.at<uchar>(y, x) = 255;
+            }
+        }
+
+        _meanCenter = cv::Point2f(
+            (float)(_shapeTransform(2, 0) - offx - Scalar(0.5)),
+            (float)(_shapeTransform(2, 1) - offy - Scalar(0.5)));
+    }
+
+    void GlobalPoseSearch::setScalings(const std::vector<Scalar>& scalings) {
+        _scalings = scalings;
+        _templates.clear();
+    }
+
+    void GlobalPoseSearch::setRotations(const std::vector<Scalar>& degrees) {
+        _rotations = degrees;
+        _templates.clear();
+    }
+
+    void GlobalPoseSearch::setPyramidLevels(int levels) {
+        _levels = std::max(levels, 0);
+        _templates.clear();
+    }
+
+    void GlobalPoseSearch::setMaxCandidates(int n) {
+        _maxCandidates = std::max(n, 1);
+    }
+
+    const GlobalPoseSearch::Template& GlobalPoseSearch::getTemplate(size_t scaling, size_t rotation, int level) {
+        const size_t nScalings = _scalings.size();
+        const size_t nRotations = _rotations.size();
+
+        if (_templates.empty()) {
+            _templates.resize((_levels + 1) * nScalings * nRotations);
+        }
+
+        Template &t = _templates[(level * nScalings + scaling) * nRotations + rotation];
+        if (!t.image.empty()) {
+            return t;
+        }
+
+        // Rotate and scale about the origin of normalized shape coordinates
+        const double s = _scalings[scaling] / double(1 << level);
+        cv::Mat m = cv::getRotationMatrix2D(_meanCenter, _rotations[rotation], s);
+
+        // Shift so that the bounds of the transformed canvas start at zero
+        const double w = _meanAppearance.cols, h = _meanAppearance.rows;
+        const double cornersX[] = { -0.5, w - 0.5, -0.5, w - 0.5 };
+        const double cornersY[] = { -0.5, -0.5, h - 0.5, h - 0.5 };
+        double minX = std::numeric_limits<double>::max(), minY = minX;
+        double maxX = -minX, maxY = -minX;
+        for (int i = 0; i < 4; ++i) {
+            const double x = m.at<double>(0, 0) * cornersX[i] + m.at<double>(0, 1) * cornersY[i] + m.at<double>(0, 2);
+            const double y = m.at<double>(1, 0) * cornersX[i] + m.at<double>(1, 1) * cornersY[i] + m.at<double>(1, 2);
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+        }
+        m.at<double>(0, 2) -= minX + 0.5;
+        m.at<double>(1, 2) -= minY + 0.5;
+
+        cv::Size size(
+            std::max(1, (int)std::ceil(maxX - minX)),
+            std::max(1, (int)std::ceil(maxY - minY)));
+
+        cv::Mat mask;
+        cv::warpAffine(_meanAppearance, t.image, m, size, cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(0));
+        cv::warpAffine(_meanMask, mask, m, size, cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(0));
+
+        // Pixels outside of the shape take the template mean, so they add nothing to the correlation.
+        // The image pixels below them still enter the normalization by the window variance.
+        double sum = 0;
+        int count = 0;
+        for (int y = 0; y < size.height; ++y) {
+            const float *ti = t.image.ptr<float>(y);
+            const uchar *mi = mask.ptr<uchar>(y);
+            for (int x = 0; x < size.width; ++x) {
+                if (mi[x]) {
+                    sum += ti[x];
+                    ++count;
+                }
+            }
+        }
+        const float fill = (float)(count > 0 ? sum / count : 0);
+        for (int y = 0; y < size.height; ++y) {
+            float *ti = t.image.ptr<float>(y);
+            const uchar *mi = mask.ptr<uchar>(y);
+            for (int x = 0; x < size.width; ++x) {
+                if (!mi[x]) {
+                    ti[x] = fill;
+                }
+            }
+        }
+
+        t.center = cv::Point2f(
+            (float)(m.at<double>(0, 0) * _meanCenter.x + m.at<double>(0, 1) * _meanCenter.y + m.at<double>(0, 2)),
+            (float)(m.at<double>(1, 0) * _meanCenter.x + m.at<double>(1, 1) * _meanCenter.y + m.at<double>(1, 2)));
+
+        return t;
+    }
+
+    void GlobalPoseSearch::search(const cv::Mat& img, std::vector<PoseCandidate>& candidates) {
+        candidates.clear();
+
+        if (_scalings.empty() || _rotations.empty()) {
+            return;
+        }
+
+        // Build image pyramid
+        std::vector<cv::Mat> pyramid(_levels + 1);
+        img.convertTo(pyramid[0], CV_32F);
+        for (int l = 1; l <= _levels; ++l) {
+            cv::pyrDown(pyramid[l - 1], pyramid[l]);
+        }
+
+        // Exhaustive search on the coarsest level
+        std::vector<SearchCandidate> found;
+        const cv::Mat &coarse = pyramid[_levels];
+        cv::Mat response;
+        float suppressionRadius = std::numeric_limits<float>::max();
+
+        for (size_t s = 0; s < _scalings.size(); ++s) {
+            for (size_t r = 0; r < _rotations.size(); ++r) {
+                const Template &t = getTemplate(s, r, _levels);
+                if (t.image.cols > coarse.cols || t.image.rows > coarse.rows) {
+                    continue;
+                }
+
+                suppressionRadius = std::min(suppressionRadius, 0.5f * std::min(t.image.cols, t.image.rows));
+
+                cv::matchTemplate(coarse, t.image, response, cv::TM_CCOEFF_NORMED);
+
+                // Take the strongest peaks, suppressing the neighborhood of each
+                const cv::Rect bounds(0, 0, response.cols, response.rows);
+                for (int n = 0; n < _maxCandidates; ++n) {
+                    double maxVal;
+                    cv::Point maxLoc;
+                    cv::minMaxLoc(response, 0, &maxVal, 0, &maxLoc);
+                    if (maxVal <= -1) {
+                        break;
+                    }
+
+                    SearchCandidate c;
+                    c.scaling = s;
+                    c.rotation = r;
+                    c.center = cv::Point2f(maxLoc.x + t.center.x, maxLoc.y + t.center.y);
+                    c.score = (Scalar)maxVal;
+                    found.push_back(c);
+
+                    const int hw = std::max(1, t.image.cols / 4);
+                    const int hh = std::max(1, t.image.rows / 4);
+                    response(cv::Rect(maxLoc.x - hw, maxLoc.y - hh, 2 * hw + 1, 2 * hh + 1) & bounds).setTo(-1);
+                }
+            }
+        }
+
+        // Non-maximum suppression across templates
+        std::sort(found.begin(), found.end(), byDecreasingScore);
+
+        std::vector<SearchCandidate> kept;
+        const float r2 = suppressionRadius * suppressionRadius;
+        for (size_t i = 0; i < found.size() && (int)kept.size() < _maxCandidates; ++i) {
+            bool suppressed = false;
+            for (size_t j = 0; j < kept.size() && !suppressed; ++j) {
+                const cv::Point2f d = found[i].center - kept[j].center;
+                suppressed = d.x * d.x + d.y * d.y < r2;
+            }
+            if (!suppressed) {
+                kept.push_back(found[i]);
+            }
+        }
+
+        // Follow candidates down the pyramid, searching a small window around the predicted position
+        const int window = 2;
+        for (int l = _levels - 1; l >= 0; --l) {
+            const cv::Mat &level = pyramid[l];
+            const cv::Rect bounds(0, 0, level.cols, level.rows);
+
+            for (size_t i = 0; i < kept.size(); ++i) {
+                SearchCandidate &c = kept[i];
+                const Template &t = getTemplate(c.scaling, c.rotation, l);
+
+                // pixel centers are located at integer positions on each level
+                c.center = cv::Point2f((c.center.x + 0.5f) * 2.f - 0.5f, (c.center.y + 0.5f) * 2.f - 0.5f);
+
+                const int x = (int)std::floor(c.center.x - t.center.x + 0.5f);
+                const int y = (int)std::floor(c.center.y - t.center.y + 0.5f);
+                const cv::Rect roi = cv::Rect(x - window, y - window, t.image.cols + 2 * window, t.image.rows + 2 * window) & bounds;
+                if (roi.width < t.image.cols || roi.height < t.image.rows) {
+                    continue;
+                }
+
+                cv::matchTemplate(level(roi), t.image, response, cv::TM_CCOEFF_NORMED);
+
+                double maxVal;
+                cv::Point maxLoc;
+                cv::minMaxLoc(response, 0, &maxVal, 0, &maxLoc);
+
+                c.center = cv::Point2f(roi.x + maxLoc.x + t.center.x, roi.y + maxLoc.y + t.center.y);
+                c.score = (Scalar)maxVal;
+            }
+        }
+
+        std::sort(kept.begin(), kept.end(), byDecreasingScore);
+
+        // Convert to global shape transforms
+        candidates.resize(kept.size());
+        for (size_t i = 0; i < kept.size(); ++i) {
+            const SearchCandidate &c = kept[i];
+            const Scalar a = _rotations[c.rotation] * Scalar(3.14159265358979 / 180.0);
+            const Scalar k = _scalings[c.scaling];
+
+            Matrix2 rs;
+            rs << std::cos(a), -std::sin(a),
+                  std::sin(a), std::cos(a);
+            rs *= k;
+
+            PoseCandidate &pc = candidates[i];
+            pc.pose.topRows<2>() = _shapeTransform.topRows<2>() * rs;
+            pc.pose(2, 0) = c.center.x + Scalar(0.5);
+            pc.pose(2, 1) = c.center.y + Scalar(0.5);
+            pc.score = c.score;
+        }
+    }
+
+}
\ No newline at end of file
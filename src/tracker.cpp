@@ -0,0 +1,122 @@
+/**
+This file is part of Active Appearance Models (AAM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AAM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AAM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AAM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <aam/tracker.h>
+#include <aam/model.h>
+#include <Eigen/LU>
+#include <limits>
+
+namespace aam {
+
+    typedef AamMatrixTraits<Scalar, 3, 3>::MatrixType Matrix3;
+
+    /** Extend compact affine transform to 3x3 for row-vector layout */
+    inline Matrix3 toMatrix3(const Affine2 &t) {
+        Matrix3 m;
+        m.block<3, 2>(0, 0) = t;
+        m(0, 2) = 0;
+        m(1, 2) = 0;
+        m(2, 2) = 1;
+        return m;
+    }
+
+    Tracker::Tracker(const ActiveAppearanceModel& model, Matcher2::Algorithm algorithm)
+        : _matcher(model, algorithm), 
+          _nShapeParams(model.shapeModeWeights.cols()),
+          _nAppearanceParams(model.appearanceModeWeights.cols()),
+          _stepsPerFrame(5), 
+          _predictPose(true), 
+          _imageMargin(16),
+          _initialized(false), 
+          _resetPending(true),
+          _x(0), _y(0), _scaling(1),
+          _framesTracked(0)
+    {}
+
+    void Tracker::setStepsPerFrame(int steps) {
+        _stepsPerFrame = steps;
+    }
+
+    void Tracker::setPosePrediction(bool enable) {
+        _predictPose = enable;
+    }
+
+    void Tracker::setImageMargin(int margin) {
+        _imageMargin = margin;
+    }
+
+    void Tracker::reset(Scalar x, Scalar y, Scalar scaling) {
+        _x = x;
+        _y = y;
+        _scaling = scaling;
+        _resetPending = true;
+    }
+
+    Scalar Tracker::fit(const cv::Mat& img, Affine2& pose, RowVectorX& shapeParams, RowVectorX& appearanceParams) {
+
+        if (_resetPending) {
+            RowVectorX initialShapeParams = RowVectorX::Zero(_nShapeParams);
+            RowVectorX initialAppearanceParams = RowVectorX::Zero(_nAppearanceParams);
+
+            if (!_initialized) {
+                // pre-compute model dependent entities only once
+                if (!_matcher.init(img, _x, _y, _scaling, initialShapeParams, initialAppearanceParams))
+                    return std::numeric_limits<Scalar>::quiet_NaN();
+                _initialized = true;
+            } else {
+                _matcher.reset(_x, _y, _scaling, initialShapeParams, initialAppearanceParams);
+            }
+            
+            _resetPending = false;
+            _framesTracked = 0;
+        } else if (_predictPose && _framesTracked >= 2) {
+            // warm-start from the parameters of the previous frame. Constant velocity: apply the 
+            // motion between the last two frames once more. With row-vectors current = last * motion, 
+            // so motion = last^-1 * current.
+            Matrix3 last = toMatrix3(_lastPose);
+            Matrix3 current = toMatrix3(_currentPose);
+            Matrix3 predicted = current * (last.inverse() * current);
+            _matcher.setCurrentGlobalTransform(predicted.block<3, 2>(0, 0));
+        }
+
+        // bind the frame, only the region around the (predicted) shape instance if requested
+        if (_imageMargin >= 0) {
+            _matcher.setImageROI(img, _imageMargin);
+        } else {
+            _matcher.setImage(img);
+        }
+
+        for (int i = 0; i < _stepsPerFrame; ++i) {
+            _matcher.step();
+        }
+
+        pose = _matcher.getCurrentGlobalTransform();
+        shapeParams = _matcher.getCurrentShapeParams();
+        appearanceParams = _matcher.getCurrentAppearanceParams();
+
+        _lastPose = _currentPose;
+        _currentPose = pose;
+        ++_framesTracked;
+
+        return _matcher.getCurrentError();
+    }
+
+}
\ No newline at end of file
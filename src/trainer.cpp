@@ -28,16 +28,58 @@ along with AAM.  If not, see <http://www.gnu.org/licenses/>.
 #include <aam/map.h>
 #include <aam/views.h>
 #include <aam/trainingset.h>
+#include <aam/io.h>
+#include <aam/instrumentation.h>
 #include <iostream>
+#include <cmath>
 
 namespace aam {
     
     Trainer::Trainer(const TrainingSet& trainingSet) 
-        :_ts(trainingSet)
+        :_ts(trainingSet), _appearanceResolution(0), _appearanceSamples(0)
     {
         eigen_assert(trainingSet.triangles.array().size() > 0);
     }
 
+    void Trainer::setAppearanceResolution(Scalar pixels) {
+        _appearanceResolution = pixels;
+        _appearanceSamples = 0;
+    }
+
+    void Trainer::setAppearanceSamples(int samples) {
+        _appearanceSamples = samples;
+        _appearanceResolution = 0;
+    }
+
+    void Trainer::scaleShapeToAppearanceResolution(Eigen::Ref<RowVectorX> shape, Eigen::Ref<RowVectorX> weights) const {
+        if (_appearanceResolution <= 0 && _appearanceSamples <= 0) {
+            return;
+        }
+
+        auto points = toSeparatedView<Scalar>(shape);
+
+        Scalar scaling = 1;
+        if (_appearanceResolution > 0) {
+            RowVector2 dia = points.colwise().maxCoeff() - points.colwise().minCoeff();
+            scaling = _appearanceResolution / dia.maxCoeff();
+        } else {
+            // One sample per pixel, so the number of samples is roughly the area covered by triangles.
+            Scalar area = 0;
+            for (MatrixX::Index tri = 0; tri < _ts.triangles.size() / 3; ++tri) {
+                RowVector2 a = points.row(_ts.triangles(tri * 3 + 1)) - points.row(_ts.triangles(tri * 3 + 0));
+                RowVector2 b = points.row(_ts.triangles(tri * 3 + 2)) - points.row(_ts.triangles(tri * 3 + 0));
+                area += std::abs(a.x() * b.y() - a.y() * b.x()) * Scalar(0.5);
+            }
+            scaling = std::sqrt(Scalar(_appearanceSamples) / area);
+        }
+
+        RowVector2 mean = points.colwise().mean();
+        points.rowwise() -= mean;
+        points *= scaling;
+        points.rowwise() += mean;
+        weights *= scaling * scaling;
+    }
+
     /** shift centroid to origin and scale to 0/1 */
     Affine2 Trainer::normalizeShape(Eigen::Ref<RowVectorX> shape, Eigen::Ref<RowVectorX> weights) const {
         // Convert points from interleaved to x,y per row.
@@ -65,28 +107,85 @@ namespace aam {
         return t;
     }
 
-    void Trainer::train(ActiveAppearanceModel& model) {
+    bool Trainer::train(ActiveAppearanceModel& model) {
+        size_t next = 0;
+        return train(model, [this, &next](cv::Mat& image) {
+            if (next >= _ts.images.size())
+                return false;
+            image = _ts.images[next++];
+            return true;
+        });
+    }
 
-        aam::MatrixX alignedShapes = generalizedProcrustes(_ts.shapes, 10);
+    bool Trainer::train(ActiveAppearanceModel& model, AsfTrainingSetLoader& loader) {
+        return train(model, [&loader](cv::Mat& image) {
+            return loader.next(image);
+        });
+    }
 
-        computePCA(
-            alignedShapes,
-            model.shapeMean, 
-            model.shapeModes,
-            model.shapeModeWeights);
+    bool Trainer::train(ActiveAppearanceModel& model, const std::function<bool(cv::Mat&)>& nextImage) {
+
+        // Shape and appearance statistics are accumulated in training precision
+        // and converted to aam::Scalar when stored in the model.
+
+        TrainingMatrixX alignedShapes;
+        {
+            AAM_SCOPED_TIMER(TRAIN_PROCRUSTES);
+            alignedShapes = generalizedProcrustes<TrainingScalar>(_ts.shapes.cast<TrainingScalar>(), 10);
+        }
+
+        TrainingRowVectorX shapeMean, shapeModeWeights;
+        TrainingMatrixX shapeModes;
+        {
+            AAM_SCOPED_TIMER(TRAIN_PCA);
+            computePCA<TrainingScalar>(
+                alignedShapes,
+                shapeMean, 
+                shapeModes,
+                shapeModeWeights);
+        }
+
+        model.shapeMean = shapeMean.cast<Scalar>();
+        model.shapeModes = shapeModes.cast<Scalar>();
+        model.shapeModeWeights = shapeModeWeights.cast<Scalar>();
+
+        // The scale of the mean shape determines the number of appearance samples. Training data
+        // coordinates (see shapeTransformToTrainingData) refer to this scale from now on.
+        scaleShapeToAppearanceResolution(model.shapeMean, model.shapeModeWeights);
+
+        // Images are requested in order, one at a time.
+        cv::Mat image;
+        if (!nextImage(image) || image.empty()) {
+            return false;
+        }
 
         model.triangleIndices = _ts.triangles;
-        model.barycentricSamplePositions = rasterizeShape(
-            model.shapeMean, 
-            model.triangleIndices, 
-            _ts.images.front().cols, 
-            _ts.images.front().rows);
+        {
+            AAM_SCOPED_TIMER(TRAIN_RASTERIZE);
+            model.barycentricSamplePositions = rasterizeShape(
+                model.shapeMean, 
+                model.triangleIndices, 
+                image.cols, 
+                image.rows);
+            AAM_COUNT(TRAIN_RASTERIZE, model.barycentricSamplePositions.rows());
+        }
 
+        // Color images yield appearance vectors with channels interleaved per sample.
         cv::Mat scalarImage;
         cv::Mat colorSamples;
-        MatrixX appearances(_ts.shapes.rows(), model.barycentricSamplePositions.rows());
-        for (size_t i = 0; i < _ts.images.size(); ++i) {            
-            _ts.images[i].convertTo(scalarImage, cv::DataType<Scalar>::depth);
+        const int nChannels = image.channels();
+        TrainingMatrixX appearances(_ts.shapes.rows(), model.barycentricSamplePositions.rows() * nChannels);
+        for (MatrixX::Index i = 0; i < _ts.shapes.rows(); ++i) {
+            if (i > 0) {
+                if (!nextImage(image) || image.empty()) {
+                    return false;
+                }
+            }
+
+            AAM_SCOPED_TIMER(TRAIN_SAMPLING);
+            AAM_COUNT(TRAIN_SAMPLING, model.barycentricSamplePositions.rows());
+
+            image.convertTo(scalarImage, cv::DataType<Scalar>::depth);
             
             readShapeImage(
                 _ts.shapes.row(i), // Use orignal shapes here.
@@ -95,18 +194,37 @@ namespace aam {
                 scalarImage,
                 colorSamples);
 
-            appearances.row(i) = toEigenHeader<Scalar>(colorSamples).transpose().row(0);
+            eigen_assert(colorSamples.channels() == nChannels);
+            appearances.row(i) = toEigenHeader<Scalar>(colorSamples.reshape(1, 1)).row(0).cast<TrainingScalar>();
         }
 
-        computePCA(
-            appearances,
+        TrainingRowVectorX appearanceMean, appearanceModeWeights;
+        TrainingMatrixX appearanceModes;
+        {
+            AAM_SCOPED_TIMER(TRAIN_PCA);
+            computePCA<TrainingScalar>(
+                appearances,
+                appearanceMean,
+                appearanceModes,
+                appearanceModeWeights);
+        }
+
+        model.appearanceMean = appearanceMean.cast<Scalar>();
+        model.appearanceModes = appearanceModes.cast<Scalar>();
+        model.appearanceModeWeights = appearanceModeWeights.cast<Scalar>();
+
+        // Template gradient used during fitting, computed on the sample grid of the mean shape.
+        computeShapeImageGradient(
+            model.shapeMean,
+            model.triangleIndices,
+            model.barycentricSamplePositions,
             model.appearanceMean,
-            model.appearanceModes,
-            model.appearanceModeWeights);
+            model.appearanceMeanGradient);
 
         // shape auf 0/1 normalisieren
         model.shapeTransformToTrainingData = normalizeShape(model.shapeMean, model.shapeModeWeights);
 
+        return true;
     }
 
     void Trainer::createTriangulation(TrainingSet& trainingSet) {
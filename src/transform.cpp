@@ -34,8 +34,12 @@ namespace aam {
     
     void transformShapeInPlace(const Affine2 &t, Eigen::Ref<RowVectorX> srcdst)
     {
-        auto x = toSeparatedView<Scalar>(srcdst);
-        x = (x.rowwise().homogeneous() * t).eval();
+        // per point, avoids a temporary for the aliased product
+        for (RowVectorX::Index i = 0; i < srcdst.cols(); i += 2) {
+            const Scalar x = srcdst(i), y = srcdst(i + 1);
+            srcdst(i) = x * t(0, 0) + y * t(1, 0) + t(2, 0);
+            srcdst(i + 1) = x * t(0, 1) + y * t(1, 1) + t(2, 1);
+        }
     }
 
     RowVectorX transformShape(const Affine2 &t, Eigen::Ref<const RowVectorX> src)
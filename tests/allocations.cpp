@@ -0,0 +1,167 @@
+/**
+This file is part of Active Appearance Models (AMM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AMM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AMM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AMM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Built as its own executable, aam_allocation_tests, since replacing malloc affects the whole process.
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include <aam/model.h>
+#include <aam/matcher.h>
+#include <aam/rasterization.h>
+#include <cstdlib>
+
+// Counting allocations requires replacing malloc, which is only done for glibc here. 
+// Eigen allocates through malloc rather than operator new.
+#if defined(__GLIBC__)
+
+#include <atomic>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+namespace {
+    std::atomic<long> allocationCount(0);
+}
+
+extern "C" void *malloc(size_t size) {
+    ++allocationCount;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+    ++allocationCount;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    ++allocationCount;
+    return __libc_realloc(ptr, size);
+}
+
+TEST_CASE("instance-api-allocations")
+{
+    // square of four landmarks, two triangles, two shape and appearance modes
+    aam::RowVectorX s(8);
+    s << 0, 0, 20, 0, 20, 20, 0, 20;
+
+    aam::ActiveAppearanceModel m;
+    m.triangleIndices.resize(6);
+    m.triangleIndices << 0, 1, 2, 0, 2, 3;
+    m.barycentricSamplePositions = aam::rasterizeShape(s, m.triangleIndices, 20, 20);
+
+    const int n = (int)m.barycentricSamplePositions.rows();
+    m.shapeMean = (s.array() - 10) / 20;
+    m.shapeModes = aam::MatrixX::Identity(2, 8);
+    m.shapeModeWeights = aam::RowVectorX::Ones(2);
+    m.shapeTransformToTrainingData << 20, 0, 0, 20, 10, 10;
+    m.appearanceMean = aam::RowVectorX::Random(n);
+    m.appearanceModes = aam::MatrixX::Identity(2, n);
+    m.appearanceModeWeights = aam::RowVectorX::Ones(2);
+
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(2);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(2);
+
+    cv::Mat img(40, 40, CV_8UC1, cv::Scalar(128));
+    aam::Matcher2 matcher(m);
+    matcher.init(img, 20, 20, 1, shapeParams, appearanceParams);
+
+    // caller provided buffers
+    aam::Affine2 pose = m.shapeTransformToTrainingData;
+    std::vector<aam::RowVector2> coords;
+    aam::RowVectorX shape(8), appearance(n);
+    aam::RowVectorX projectedShapeParams(2), projectedAppearanceParams(2);
+
+    aam::RowVectorX params(2);
+    params << aam::Scalar(0.1), aam::Scalar(-0.2);
+
+    // first call sizes the coordinates
+    m.getCartesianPixelCoordinates(pose, params, coords);
+    REQUIRE(coords.size() == (size_t)n);
+
+    const long before = allocationCount;
+    for (int i = 0; i < 10; ++i) {
+        m.getCartesianPixelCoordinates(pose, params, coords);
+        m.reconstructShape(params, shape);
+        m.projectShape(shape, projectedShapeParams);
+        m.reconstructAppearance(params, appearance);
+        m.projectAppearance(appearance, projectedAppearanceParams);
+        shapeParams = matcher.getCurrentShapeParams();
+        appearanceParams = matcher.getCurrentAppearanceParams();
+        pose = matcher.getCurrentGlobalTransform();
+    }
+    const long after = allocationCount;
+
+    REQUIRE(after == before);
+    REQUIRE(projectedShapeParams.isApprox(params));
+    REQUIRE(projectedAppearanceParams.isApprox(params));
+}
+
+TEST_CASE("fit-step-allocations")
+{
+    aam::RowVectorX s(8);
+    s << 0, 0, 20, 0, 20, 20, 0, 20;
+
+    aam::ActiveAppearanceModel m;
+    m.triangleIndices.resize(6);
+    m.triangleIndices << 0, 1, 2, 0, 2, 3;
+    m.barycentricSamplePositions = aam::rasterizeShape(s, m.triangleIndices, 20, 20);
+
+    const int n = (int)m.barycentricSamplePositions.rows();
+    m.shapeMean = (s.array() - 10) / 20;
+    m.shapeModes = aam::MatrixX::Identity(2, 8);
+    m.shapeModeWeights = aam::RowVectorX::Ones(2);
+    m.shapeTransformToTrainingData << 20, 0, 0, 20, 10, 10;
+    m.appearanceMean = aam::RowVectorX::Random(n) * 50 + aam::RowVectorX::Constant(n, 128);
+    m.appearanceMeanGradient = aam::MatrixX::Random(n, 2);
+    m.appearanceModes = aam::MatrixX::Identity(2, n);
+    m.appearanceModeWeights = aam::RowVectorX::Ones(2);
+
+    cv::Mat img(40, 40, CV_8UC1);
+    for (int r = 0; r < img.rows; ++r) {
+        for (int c = 0; c < img.cols; ++c) {
+            img.at<unsigned char>(r, c) = (unsigned char)((r * 7 + c * 13) % 256);
+        }
+    }
+
+    aam::Matcher2::Algorithm algorithms[] = { aam::Matcher2::PROJECT_OUT, aam::Matcher2::SIMULTANEOUS, aam::Matcher2::PROJECT_OUT };
+
+    for (int a = 0; a < 3; ++a) {
+        aam::RowVectorX shapeParams = aam::RowVectorX::Zero(2);
+        aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(2);
+
+        aam::Matcher2 matcher(m, algorithms[a]);
+        matcher.init(img, 21, 19, 1, shapeParams, appearanceParams);
+        if (a == 2) {
+            matcher.setRobustError(aam::Matcher2::HUBER);
+            matcher.setSampleSubsets(aam::Matcher2::STRATIFIED_RANDOM, n / 2, 2);
+        }
+
+        // buffers are sized by init, steps reuse them
+        const long before = allocationCount;
+        for (int i = 0; i < 5; ++i) {
+            matcher.step();
+        }
+        const long after = allocationCount;
+
+        REQUIRE(after == before);
+    }
+}
+
+#endif
\ No newline at end of file
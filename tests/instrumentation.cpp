@@ -0,0 +1,89 @@
+/**
+This file is part of Active Appearance Models (AMM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AMM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AMM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AMM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "catch.hpp"
+#include <aam/instrumentation.h>
+#include <thread>
+
+TEST_CASE("instrumentation")
+{
+    namespace ai = aam::instrumentation;
+
+    ai::reset();
+    ai::Report r = ai::report();
+    REQUIRE(r[ai::FIT_STEP].calls == 0);
+    REQUIRE(r[ai::FIT_STEP].totalSeconds == 0);
+
+    ai::record(ai::FIT_STEP, std::chrono::milliseconds(2));
+    ai::record(ai::FIT_STEP, std::chrono::milliseconds(5));
+    ai::count(ai::FIT_STEP, 3);
+    {
+        ai::ScopedTimer timer(ai::TRAIN_PCA);
+    }
+
+    r = ai::report();
+    REQUIRE(r[ai::FIT_STEP].calls == 2);
+    REQUIRE(r[ai::FIT_STEP].items == 3);
+    REQUIRE(r[ai::FIT_STEP].totalSeconds == Approx(0.007));
+    REQUIRE(r[ai::FIT_STEP].maxSeconds == Approx(0.005));
+    REQUIRE(r[ai::TRAIN_PCA].calls == 1);
+    REQUIRE(r[ai::FIT_SAMPLING].calls == 0);
+    REQUIRE(std::string(r[ai::FIT_STEP].name) == "fit_step");
+
+    // Macros only record when compiled in
+    {
+        AAM_SCOPED_TIMER(LOAD_PARSE);
+        AAM_COUNT(LOAD_PARSE, 10);
+    }
+    r = ai::report();
+#ifdef AAM_INSTRUMENTATION
+    REQUIRE(r.enabled);
+    REQUIRE(r[ai::LOAD_PARSE].calls == 1);
+    REQUIRE(r[ai::LOAD_PARSE].items == 10);
+#else
+    REQUIRE(!r.enabled);
+    REQUIRE(r[ai::LOAD_PARSE].calls == 0);
+    REQUIRE(r[ai::LOAD_PARSE].items == 0);
+#endif
+
+    // Concurrent updates are not lost
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.push_back(std::thread([]() {
+            for (int i = 0; i < 1000; ++i) {
+                ai::record(ai::LOAD_DECODE, std::chrono::microseconds(1));
+                ai::count(ai::LOAD_DECODE, 1);
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    r = ai::report();
+    REQUIRE(r[ai::LOAD_DECODE].calls == 4000);
+    REQUIRE(r[ai::LOAD_DECODE].items == 4000);
+
+    std::string json = r.toJson();
+    REQUIRE(json.find("\"fit_step\":{\"calls\":2,\"items\":3,\"total_ms\":7,\"max_ms\":5}") != std::string::npos);
+    REQUIRE(json.find("\"load_decode\":{\"calls\":4000") != std::string::npos);
+
+    ai::reset();
+    REQUIRE(ai::report()[ai::LOAD_DECODE].calls == 0);
+}
\ No newline at end of file
@@ -50,14 +50,14 @@ TEST_CASE("map-header-only")
     aam::MatrixX mEigen = aam::MatrixX::Random(8, 6);
 
     // Map to OpenCV
-    cv::Mat_<float> mOpenCVMapped = aam::toOpenCVHeader<float>(mEigen);
+    cv::Mat_<aam::Scalar> mOpenCVMapped = aam::toOpenCVHeader<aam::Scalar>(mEigen);
     REQUIRE(compareForMatricesForEquality(mOpenCVMapped, mEigen));
 
     // Create non-contingous view of mat
     cv::Mat roi = mOpenCVMapped(cv::Rect(1, 1, 2, 2));
 
     // Map non-contingous back to eigen
-    aam::MapMatrixX roiMapped = aam::toEigenHeader<float>(roi);
+    aam::MapMatrixX roiMapped = aam::toEigenHeader<aam::Scalar>(roi);
     REQUIRE(compareForMatricesForEquality(roi, roiMapped));
 
     // Try with image data, 3 channels
@@ -82,8 +82,8 @@ TEST_CASE("map-header-only")
     REQUIRE(compareForMatricesForEquality(img.reshape(1), eigenMapped));
     
     // Regression compile issue #1 was caused by having a different stride on Map and Ref.
-    cv::Mat m(1,1, CV_32FC1);
+    cv::Mat_<aam::Scalar> m(1,1);
     m.setTo(255);
-    funcTakingMatrixRef(aam::toEigenHeader<float>(m));
+    funcTakingMatrixRef(aam::toEigenHeader<aam::Scalar>(m));
     REQUIRE(cv::countNonZero(m) == 0);
 }
\ No newline at end of file
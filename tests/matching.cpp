@@ -20,12 +20,631 @@ along with AMM.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "catch.hpp"
 #include <aam/matcher.h>
+#include <aam/multistart.h>
+#include <aam/search.h>
+#include <aam/tracker.h>
+#include <aam/instrumentation.h>
+#include <aam/rasterization.h>
+#include <aam/barycentrics.h>
 #include <iostream>
+#include <cmath>
 
-TEST_CASE("match")
+namespace {
+
+    /** Smooth synthetic texture */
+    aam::Scalar texture(aam::Scalar x, aam::Scalar y) {
+        const aam::Scalar pi = aam::Scalar(3.14159265);
+        return 128 + 50 * std::sin(2 * pi * x / 40) + 50 * std::cos(2 * pi * y / 50);
+    }
+
+    /** Synthetic model consisting of a regular 3x3 grid of landmarks, a single 
+        shape mode moving the center landmark and a single brightness mode. */
+    aam::ActiveAppearanceModel createSyntheticModel() {
+        aam::ActiveAppearanceModel m;
+
+        aam::RowVectorX s(18);
+        for (int i = 0; i < 9; ++i) {
+            s(i * 2 + 0) = aam::Scalar(10 + 30 * (i % 3));
+            s(i * 2 + 1) = aam::Scalar(10 + 30 * (i / 3));
+        }
+
+        m.triangleIndices.resize(24);
+        m.triangleIndices << 0, 1, 4, 0, 4, 3, 1, 2, 5, 1, 5, 4, 3, 4, 7, 3, 7, 6, 4, 5, 8, 4, 8, 7;
+        m.barycentricSamplePositions = aam::rasterizeShape(s, m.triangleIndices, 80, 80);
+
+        std::vector<aam::RowVector2> coords;
+        aam::barycentricToCartesian(s, m.triangleIndices, m.barycentricSamplePositions, coords);
+
+        const int n = (int)coords.size();
+        m.appearanceMean.resize(n);
+        for (int i = 0; i < n; ++i) {
+            m.appearanceMean(i) = texture(coords[i].x(), coords[i].y());
+        }
+        aam::computeShapeImageGradient(s, m.triangleIndices, m.barycentricSamplePositions, m.appearanceMean, m.appearanceMeanGradient);
+
+        m.appearanceModes = aam::MatrixX::Constant(1, n, aam::Scalar(1) / std::sqrt(aam::Scalar(n)));
+        m.appearanceModeWeights = aam::RowVectorX::Constant(1, 100);
+        
+        m.shapeModes = aam::MatrixX::Zero(1, 18);
+        m.shapeModes(0, 8) = 1;
+        m.shapeModeWeights = aam::RowVectorX::Constant(1, aam::Scalar(0.01));
+
+        m.shapeTransformToTrainingData << 60, 0, 0, 60, 40, 40;
+        m.shapeMean = (s.array() - 40) / 60;
+
+        return m;
+    }
+
+    /** Render the texture shifted by the given offset, brightened by 10 gray values unless specified 
+        otherwise. Pixel values are taken at pixel centers, like the sample positions of the model. */
+    cv::Mat createSyntheticImage(int offsetX, int offsetY, aam::Scalar brightness = 10) {
+        cv::Mat img(160, 160, CV_8U);
+        for (int r = 0; r < img.rows; ++r) {
+            for (int c = 0; c < img.cols; ++c) {
+                img.at<unsigned char>(r, c) = (unsigned char)(texture(c + aam::Scalar(0.5) - offsetX, r + aam::Scalar(0.5) - offsetY) + brightness);
+            }
+        }
+        return img;
+    }
+}
+
+TEST_CASE("match-project-out")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    // Ground truth translation is (70, 60), start off by a few pixels.
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
+
+    aam::Matcher2 matcher(m);
+    matcher.init(img, 74, 57, 1, shapeParams, appearanceParams);
+
+    aam::instrumentation::reset();
+    for (int i = 0; i < 60; ++i) {
+        matcher.step();
+    }
+
+#ifdef AAM_INSTRUMENTATION
+    // Steps and damping trials are counted separately, each step tries at least one update.
+    aam::instrumentation::Report r = aam::instrumentation::report();
+    REQUIRE(r[aam::instrumentation::FIT_STEP].calls == 60);
+    REQUIRE(r[aam::instrumentation::FIT_STEP].items == 60);
+    REQUIRE(r[aam::instrumentation::FIT_TRIAL].items >= 60);
+    REQUIRE(r[aam::instrumentation::FIT_TRIAL].calls == r[aam::instrumentation::FIT_TRIAL].items);
+#endif
+
+    // Model and image agree on pixel centers, the fit is limited by quantization and interpolation only.
+    aam::Affine2 t = matcher.getCurrentGlobalTransform();
+    REQUIRE(std::abs(t(2, 0) - 70) < aam::Scalar(0.05));
+    REQUIRE(std::abs(t(2, 1) - 60) < aam::Scalar(0.05));
+    REQUIRE(std::abs(t(0, 0) - 60) < aam::Scalar(0.05));
+    REQUIRE(std::abs(t(0, 1)) < aam::Scalar(0.01));
+
+    // Brightness offset is captured by the appearance mode.
+    REQUIRE(matcher.getCurrentAppearanceParams()(0, 0) > 0);
+}
+
+TEST_CASE("match-simultaneous")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
+
+    aam::Matcher2 matcher(m, aam::Matcher2::SIMULTANEOUS);
+    matcher.init(img, 74, 57, 1, shapeParams, appearanceParams);
+
+    for (int i = 0; i < 60; ++i) {
+        matcher.step();
+    }
+
+    aam::Affine2 t = matcher.getCurrentGlobalTransform();
+    REQUIRE(std::abs(t(2, 0) - 70) < aam::Scalar(0.05));
+    REQUIRE(std::abs(t(2, 1) - 60) < aam::Scalar(0.05));
+    REQUIRE(std::abs(t(0, 0) - 60) < aam::Scalar(0.05));
+    REQUIRE(std::abs(t(0, 1)) < aam::Scalar(0.01));
+
+    // Brightness offset of 10 gray values is explained by the appearance mode, leaving
+    // the residual of quantization and interpolation only.
+    REQUIRE(matcher.getCurrentAppearanceParams()(0, 0) > 0);
+    REQUIRE(matcher.getCurrentError() < 1);
+}
+
+TEST_CASE("match-sample-subsets")
 {
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
     
-	// TODO: implement test for AAM matching
-	
-    REQUIRE(true);    
+    const int nSamples = (int)m.barycentricSamplePositions.rows();
+
+    SECTION("stratified-random") {
+        aam::Matcher2 matcher(m);
+        matcher.init(img, 74, 57, 1, shapeParams, appearanceParams);
+        matcher.setSampleSubsets(aam::Matcher2::STRATIFIED_RANDOM, nSamples / 5, 4);
+
+        for (int i = 0; i < 60; ++i) {
+            matcher.step();
+        }
+
+        matcher.useAllSamples();
+        for (int i = 0; i < 10; ++i) {
+            matcher.step();
+        }
+
+        aam::Affine2 t = matcher.getCurrentGlobalTransform();
+        REQUIRE(std::abs(t(2, 0) - 70) < 1);
+        REQUIRE(std::abs(t(2, 1) - 60) < 1);
+    }
+
+    SECTION("gradient-magnitude") {
+        aam::Matcher2 matcher(m, aam::Matcher2::SIMULTANEOUS);
+        matcher.init(img, 74, 57, 1, shapeParams, appearanceParams);
+        matcher.setSampleSubsets(aam::Matcher2::GRADIENT_MAGNITUDE, nSamples / 5);
+
+        for (int i = 0; i < 60; ++i) {
+            matcher.step();
+        }
+
+        aam::Affine2 t = matcher.getCurrentGlobalTransform();
+        REQUIRE(std::abs(t(2, 0) - 70) < 1);
+        REQUIRE(std::abs(t(2, 1) - 60) < 1);
+    }
+}
+
+TEST_CASE("match-subset-seeds")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
+
+    const int nSamples = (int)m.barycentricSamplePositions.rows();
+
+    aam::Matcher2 prototype(m);
+    prototype.init(img, 74, 57, 1, shapeParams, appearanceParams);
+    prototype.setSampleSubsets(aam::Matcher2::STRATIFIED_RANDOM, nSamples / 20, 8);
+
+    // Copies continue the random sequence of the prototype and draw the same subsets.
+    std::vector<aam::Matcher2> copies(4, prototype);
+    copies[2].setSeed(7);
+    copies[3].setSeed(7);
+    for (size_t c = 0; c < copies.size(); ++c) {
+        for (int i = 0; i < 5; ++i) {
+            copies[c].step();
+        }
+    }
+
+    REQUIRE(copies[0].getCurrentGlobalTransform() == copies[1].getCurrentGlobalTransform());
+    REQUIRE(copies[2].getCurrentGlobalTransform() == copies[3].getCurrentGlobalTransform());
+    REQUIRE(copies[0].getCurrentGlobalTransform() != copies[2].getCurrentGlobalTransform());
+}
+
+TEST_CASE("match-small-sample-subsets")
+{
+    // Three orthonormal appearance modes, subsets of fewer samples cannot determine them.
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    const int n = (int)m.appearanceMean.cols();
+    aam::MatrixX modes = aam::MatrixX::Random(3, n);
+    modes.row(0) = m.appearanceModes.row(0);
+    for (int r = 1; r < 3; ++r) {
+        for (int q = 0; q < r; ++q) {
+            modes.row(r) -= modes.row(r).dot(modes.row(q)) * modes.row(q);
+        }
+        modes.row(r).normalize();
+    }
+    m.appearanceModes = modes;
+    m.appearanceModeWeights = aam::RowVectorX::Constant(3, 100);
+
+    cv::Mat img = createSyntheticImage(30, 20);
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(3);
+
+    aam::Matcher2::Algorithm algorithms[] = { aam::Matcher2::PROJECT_OUT, aam::Matcher2::SIMULTANEOUS };
+    aam::Matcher2::SampleSelection selections[] = { aam::Matcher2::GRADIENT_MAGNITUDE, aam::Matcher2::STRATIFIED_RANDOM };
+
+    for (int a = 0; a < 2; ++a) {
+        for (int s = 0; s < 2; ++s) {
+            aam::Matcher2 matcher(m, algorithms[a]);
+            REQUIRE(matcher.init(img, 74, 57, 1, shapeParams, appearanceParams));
+            matcher.setSampleSubsets(selections[s], 1, 4);
+
+            for (int i = 0; i < 10; ++i) {
+                matcher.step();
+            }
+            REQUIRE(matcher.getCurrentGlobalTransform().allFinite());
+            REQUIRE(matcher.getCurrentAppearanceParams().allFinite());
+
+            // Updates from a handful of samples are noisy and may end in any local minimum, but 
+            // entities pre-computed for all samples are left intact.
+            matcher.useAllSamples();
+            matcher.reset(74, 57, 1, shapeParams, appearanceParams);
+            for (int i = 0; i < 10; ++i) {
+                matcher.step();
+            }
+
+            aam::Affine2 t = matcher.getCurrentGlobalTransform();
+            REQUIRE(std::abs(t(2, 0) - 70) < 1);
+            REQUIRE(std::abs(t(2, 1) - 60) < 1);
+        }
+    }
+}
+
+TEST_CASE("match-dependent-appearance-modes")
+{
+    // Two identical appearance modes cannot be told apart on any set of samples.
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    aam::MatrixX modes(2, m.appearanceModes.cols());
+    modes << m.appearanceModes, m.appearanceModes;
+    m.appearanceModes = modes;
+    m.appearanceModeWeights = aam::RowVectorX::Constant(2, 100);
+
+    cv::Mat img = createSyntheticImage(30, 20);
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(2);
+
+    aam::Matcher2 projectOut(m, aam::Matcher2::PROJECT_OUT);
+    REQUIRE(!projectOut.init(img, 74, 57, 1, shapeParams, appearanceParams));
+
+    aam::Matcher2 simultaneous(m, aam::Matcher2::SIMULTANEOUS);
+    REQUIRE(!simultaneous.init(img, 74, 57, 1, shapeParams, appearanceParams));
+
+    // Failures are passed on by matchers built on top
+    aam::Affine2 pose;
+    aam::Tracker tracker(m);
+    tracker.reset(74, 57, 1);
+    aam::Scalar error = tracker.fit(img, pose, shapeParams, appearanceParams);
+    REQUIRE(error != error);
+
+    std::vector<aam::InstanceFit> results(1);
+    aam::MultiInstanceMatcher instances(m);
+    REQUIRE(!instances.fit(img, std::vector<aam::Affine2>(2, m.shapeTransformToTrainingData), results));
+    REQUIRE(results.empty());
+}
+
+TEST_CASE("match-robust")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    // Occlude about a quarter of the model instance
+    for (int r = 30; r < 62; ++r) {
+        for (int c = 40; c < 72; ++c) {
+            img.at<unsigned char>(r, c) = 255;
+        }
+    }
+
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
+
+    aam::Matcher2 matcher(m);
+    matcher.init(img, 74, 57, 1, shapeParams, appearanceParams);
+    matcher.setRobustError(aam::Matcher2::TUKEY);
+
+    for (int i = 0; i < 80; ++i) {
+        matcher.step();
+    }
+
+    aam::Affine2 t = matcher.getCurrentGlobalTransform();
+    REQUIRE(std::abs(t(2, 0) - 70) < 1);
+    REQUIRE(std::abs(t(2, 1) - 60) < 1);
+    REQUIRE(std::abs(t(0, 0) - 60) < 3);
+    REQUIRE(std::abs(t(0, 1)) < 1);
+}
+
+TEST_CASE("match-robust-appearance")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+
+    // Strong brightness offset without any occlusion. The offset is explained by the appearance 
+    // mode and must not be taken for outliers.
+    cv::Mat img = createSyntheticImage(30, 20, 25);
+
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
+
+    aam::Matcher2 plain(m);
+    plain.init(img, 74, 57, 1, shapeParams, appearanceParams);
+
+    aam::Matcher2 robust(m);
+    robust.init(img, 74, 57, 1, shapeParams, appearanceParams);
+    robust.setRobustError(aam::Matcher2::TUKEY, 5);
+
+    for (int i = 0; i < 60; ++i) {
+        plain.step();
+        robust.step();
+    }
+
+    aam::Affine2 tp = plain.getCurrentGlobalTransform();
+    aam::Affine2 tr = robust.getCurrentGlobalTransform();
+    REQUIRE(std::abs(tp(2, 0) - 70) < aam::Scalar(0.05));
+    REQUIRE(std::abs(tp(2, 1) - 60) < aam::Scalar(0.05));
+    REQUIRE((tr.isApprox(tp, aam::Scalar(0.001))));
+    REQUIRE(std::abs(robust.getCurrentShapeParams()(0, 0) - plain.getCurrentShapeParams()(0, 0)) < aam::Scalar(0.01));
+    REQUIRE(robust.getCurrentAppearanceParams()(0, 0) > 0);
+}
+
+TEST_CASE("match-levenberg-marquardt")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
+
+    // converged translation
+    aam::Matcher2 reference(m);
+    reference.init(img, 74, 57, 1, shapeParams, appearanceParams);
+    for (int i = 0; i < 60; ++i) {
+        reference.step();
+    }
+    const aam::Affine2 target = reference.getCurrentGlobalTransform();
+
+    const aam::Scalar tolerance = aam::Scalar(0.1);
+    const int maxSteps = 100;
+
+    aam::Matcher2 lm(m);
+    lm.init(img, 74, 57, 1, shapeParams, appearanceParams);
+    int lmSteps = 0;
+    while (lmSteps < maxSteps && (lm.getCurrentGlobalTransform().row(2) - target.row(2)).norm() > tolerance) {
+        lm.step();
+        ++lmSteps;
+    }
+
+    // The former schedule applied a tenth of the Gauss-Newton update per step. Emulate it by moving 
+    // a tenth of the way towards the (barely damped) update of a step from its initial damping.
+    aam::Matcher2 fixed(m);
+    fixed.init(img, 74, 57, 1, shapeParams, appearanceParams);
+    int fixedSteps = 0;
+    while (fixedSteps < maxSteps && (fixed.getCurrentGlobalTransform().row(2) - target.row(2)).norm() > tolerance) {
+        const aam::Affine2 warp = fixed.getCurrentGlobalTransform();
+        const aam::RowVectorX params = fixed.getCurrentShapeParams();
+        fixed.step();
+        fixed.setCurrentShapeParams(params + aam::Scalar(0.1) * (fixed.getCurrentShapeParams() - params));
+        fixed.setCurrentGlobalTransform(warp + aam::Scalar(0.1) * (fixed.getCurrentGlobalTransform() - warp));
+        ++fixedSteps;
+    }
+
+    REQUIRE(lmSteps < 10);
+    REQUIRE(fixedSteps > 2 * lmSteps);
+}
+
+TEST_CASE("match-image-roi")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
+
+    aam::Matcher2::Algorithm algorithms[] = { aam::Matcher2::PROJECT_OUT, aam::Matcher2::SIMULTANEOUS };
+    for (int a = 0; a < 2; ++a) {
+        aam::Matcher2 full(m, algorithms[a]);
+        full.init(img, 76, 55, 1, shapeParams, appearanceParams);
+
+        // Without margin the fit leaves the initial region within the first steps.
+        aam::Matcher2 roi(m, algorithms[a]);
+        roi.init(img, 76, 55, 1, shapeParams, appearanceParams);
+        roi.setImageROI(img, 0);
+
+        for (int i = 0; i < 10; ++i) {
+            full.step();
+            roi.step();
+            REQUIRE(roi.getCurrentGlobalTransform().isApprox(full.getCurrentGlobalTransform()));
+        }
+
+        REQUIRE(roi.getCurrentError() == Approx(full.getCurrentError()));
+
+        aam::Affine2 t = roi.getCurrentGlobalTransform();
+        REQUIRE(std::abs(t(2, 0) - 70) < 1);
+        REQUIRE(std::abs(t(2, 1) - 60) < 1);
+    }
+}
+
+TEST_CASE("match-multi-start")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    // Grid of starting positions, ground truth translation is (70, 60)
+    aam::MultiStartMatcher matcher(m);
+    matcher.setPositionGrid(cv::Rect(0, 0, img.cols, img.rows), 4, 4);
+    matcher.setCoarseFitting(20, aam::Scalar(0.25));
+    matcher.setRefinement(3, 40);
+
+    aam::Affine2 pose;
+    aam::RowVectorX shapeParams, appearanceParams;
+    aam::Scalar error = matcher.fit(img, pose, shapeParams, appearanceParams);
+    REQUIRE(error < 10);
+
+    // The reported error is measured on all samples at the returned parameters.
+    aam::Matcher2 check(m);
+    REQUIRE(check.init(img, pose, shapeParams, appearanceParams));
+    REQUIRE(std::abs(check.measureCurrentError() - error) < aam::Scalar(0.001));
+
+    // The texture repeats every 40 pixels horizontally and 50 pixels vertically, so translations 
+    // differing from the ground truth by whole periods fit equally well.
+    REQUIRE(std::abs(std::remainder(pose(2, 0) - 70, aam::Scalar(40))) < 1);
+    REQUIRE(std::abs(std::remainder(pose(2, 1) - 60, aam::Scalar(50))) < 1);
+    REQUIRE(shapeParams.cols() == 1);
+    REQUIRE(appearanceParams.cols() == 1);
+}
+
+TEST_CASE("match-global-pose-search")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    // The texture is periodic, keep it only within the shape instance to make the pose unique
+    const cv::Rect instance(40, 30, 60, 60);
+    for (int r = 0; r < img.rows; ++r) {
+        for (int c = 0; c < img.cols; ++c) {
+            if (!instance.contains(cv::Point(c, r))) {
+                img.at<unsigned char>(r, c) = 128;
+            }
+        }
+    }
+
+    aam::GlobalPoseSearch search(m);
+    search.setScalings({ aam::Scalar(0.8), aam::Scalar(1), aam::Scalar(1.25) });
+    search.setRotations({ aam::Scalar(-10), aam::Scalar(0), aam::Scalar(10) });
+    search.setPyramidLevels(1);
+    search.setMaxCandidates(3);
+
+    std::vector<aam::PoseCandidate> candidates;
+    search.search(img, candidates);
+
+    // Ground truth is the training pose translated to (70, 60)
+    REQUIRE(!candidates.empty());
+    REQUIRE(candidates.size() <= 3);
+    REQUIRE(std::abs(candidates[0].pose(2, 0) - 70) < 2);
+    REQUIRE(std::abs(candidates[0].pose(2, 1) - 60) < 2);
+    REQUIRE(candidates[0].pose.topRows<2>().isApprox(m.shapeTransformToTrainingData.topRows<2>()));
+
+    // Refine by gradient based fitting
+    aam::Matcher2 matcher(m);
+    aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+    aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
+    matcher.init(img, candidates[0].pose, shapeParams, appearanceParams);
+    for (int i = 0; i < 40; ++i) {
+        matcher.step();
+    }
+
+    aam::Affine2 pose = matcher.getCurrentGlobalTransform();
+    REQUIRE(std::abs(pose(2, 0) - 70) < 1);
+    REQUIRE(std::abs(pose(2, 1) - 60) < 1);
+}
+
+TEST_CASE("match-multi-instance")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+    cv::Mat img = createSyntheticImage(30, 20);
+
+    // The texture is periodic with 40 by 50 pixels, so instances fit at (70, 60) and (110, 110).
+    std::vector<aam::Affine2> poses(2, m.shapeTransformToTrainingData);
+    poses[0](2, 0) = 74; poses[0](2, 1) = 57;
+    poses[1](2, 0) = 107; poses[1](2, 1) = 113;
+
+    aam::MultiInstanceMatcher matcher(m);
+    matcher.setSteps(60);
+
+    std::vector<aam::InstanceFit> results;
+    matcher.fit(img, poses, results);
+
+    REQUIRE(results.size() == 2);
+    REQUIRE(std::abs(results[0].pose(2, 0) - 70) < 1);
+    REQUIRE(std::abs(results[0].pose(2, 1) - 60) < 1);
+    REQUIRE(std::abs(results[1].pose(2, 0) - 110) < 1);
+    REQUIRE(std::abs(results[1].pose(2, 1) - 110) < 1);
+    REQUIRE(results[0].shapeParams.cols() == 1);
+    REQUIRE(results[1].appearanceParams.cols() == 1);
+
+    // Fitting another frame reuses the pre-computation
+    cv::Mat next = createSyntheticImage(32, 20);
+    matcher.fit(next, poses, results);
+    REQUIRE(std::abs(results[0].pose(2, 0) - 72) < 1);
+    REQUIRE(std::abs(results[1].pose(2, 0) - 112) < 1);
+}
+
+TEST_CASE("match-color")
+{
+    // Color variant of the synthetic model, channels derived from the gray texture
+    aam::ActiveAppearanceModel gray = createSyntheticModel();
+    aam::ActiveAppearanceModel m = gray;
+
+    const int n = (int)gray.appearanceMean.cols();
+    m.appearanceMean.resize(n * 3);
+    for (int i = 0; i < n; ++i) {
+        aam::Scalar v = gray.appearanceMean(i);
+        m.appearanceMean.segment(i * 3, 3) << v, 255 - v, aam::Scalar(0.5) * v + 60;
+    }
+    m.appearanceModes = aam::MatrixX::Constant(1, n * 3, aam::Scalar(1) / std::sqrt(aam::Scalar(n * 3)));
+    m.appearanceMeanGradient.resize(0, 2);
+
+    REQUIRE(m.appearanceChannels() == 3);
+
+    cv::Mat grayImg = createSyntheticImage(30, 20);
+    cv::Mat img(grayImg.rows, grayImg.cols, CV_8UC3);
+    for (int r = 0; r < img.rows; ++r) {
+        for (int c = 0; c < img.cols; ++c) {
+            aam::Scalar v = grayImg.at<unsigned char>(r, c) - aam::Scalar(10);
+            img.at<cv::Vec3b>(r, c) = cv::Vec3b(
+                cv::saturate_cast<uchar>(v + 10), 
+                cv::saturate_cast<uchar>(255 - v + 10), 
+                cv::saturate_cast<uchar>(aam::Scalar(0.5) * v + 70));
+        }
+    }
+
+    aam::Matcher2::Algorithm algorithms[] = { aam::Matcher2::PROJECT_OUT, aam::Matcher2::SIMULTANEOUS };
+    for (int a = 0; a < 2; ++a) {
+        aam::RowVectorX shapeParams = aam::RowVectorX::Zero(1);
+        aam::RowVectorX appearanceParams = aam::RowVectorX::Zero(1);
+
+        aam::Matcher2 matcher(m, algorithms[a]);
+        matcher.init(img, 74, 57, 1, shapeParams, appearanceParams);
+
+        for (int i = 0; i < 10; ++i) {
+            matcher.step();
+        }
+
+        aam::Affine2 t = matcher.getCurrentGlobalTransform();
+        REQUIRE(std::abs(t(2, 0) - 70) < 1);
+        REQUIRE(std::abs(t(2, 1) - 60) < 1);
+        REQUIRE(std::abs(t(0, 0) - 60) < 1);
+        REQUIRE(matcher.getCurrentAppearanceParams()(0, 0) > 0);
+    }
+}
+
+TEST_CASE("match-tracker")
+{
+    aam::ActiveAppearanceModel m = createSyntheticModel();
+
+    aam::Affine2 pose;
+    aam::RowVectorX shapeParams, appearanceParams;
+
+    // The instance moves by (3, 1) pixels per frame, its translation is (70, 60) in the first frame.
+    aam::Tracker tracker(m);
+    tracker.reset(74, 57, 1);
+    for (int f = 0; f < 8; ++f) {
+        cv::Mat frame = createSyntheticImage(30 + 3 * f, 20 + f);
+        REQUIRE(tracker.fit(frame, pose, shapeParams, appearanceParams) < 20);
+        REQUIRE(std::abs(pose(2, 0) - (70 + 3 * f)) < 1);
+        REQUIRE(std::abs(pose(2, 1) - (60 + f)) < 1);
+        REQUIRE(shapeParams.cols() == 1);
+        REQUIRE(appearanceParams.cols() == 1);
+    }
+
+    // Without matching steps the pose is the prediction from the last two frames.
+    cv::Mat frame = createSyntheticImage(30 + 3 * 8, 20 + 8);
+    aam::Affine2 before = pose;
+    tracker.setStepsPerFrame(0);
+    tracker.fit(frame, pose, shapeParams, appearanceParams);
+    REQUIRE(std::abs(pose(2, 0) - (before(2, 0) + 3)) < 1);
+    REQUIRE(std::abs(pose(2, 1) - (before(2, 1) + 1)) < 1);
+    REQUIRE((pose.block<2, 2>(0, 0).isApprox(before.block<2, 2>(0, 0), aam::Scalar(0.01))));
+
+    tracker.setPosePrediction(false);
+    before = pose;
+    tracker.fit(frame, pose, shapeParams, appearanceParams);
+    REQUIRE(pose.isApprox(before));
+
+    // Reset restarts at the given pose with zero parameters, re-using the pre-computed entities.
+    tracker.reset(44, 63, 1);
+    tracker.fit(frame, pose, shapeParams, appearanceParams);
+    REQUIRE(pose(2, 0) == Approx(44));
+    REQUIRE(pose(2, 1) == Approx(63));
+    REQUIRE(shapeParams.isZero());
+    REQUIRE(appearanceParams.isZero());
+
+    // The instance in the frame is at (94, 68), re-acquire it from a nearby pose.
+    tracker.setStepsPerFrame(10);
+    tracker.reset(97, 66, 1);
+    tracker.fit(frame, pose, shapeParams, appearanceParams);
+    REQUIRE(std::abs(pose(2, 0) - 94) < 1);
+    REQUIRE(std::abs(pose(2, 1) - 68) < 1);
 }
\ No newline at end of file
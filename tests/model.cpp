@@ -0,0 +1,59 @@
+/**
+This file is part of Active Appearance Models (AMM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AMM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AMM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AMM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "catch.hpp"
+#include <aam/model.h>
+#include <Eigen/QR>
+
+TEST_CASE("model-reconstruct-project")
+{
+    aam::ActiveAppearanceModel m;
+
+    // two orthonormal modes over six dimensions
+    Eigen::HouseholderQR<aam::MatrixX> qr(aam::MatrixX::Random(6, 2));
+    aam::MatrixX q = qr.householderQ() * aam::MatrixX::Identity(6, 2);
+
+    m.shapeMean = aam::RowVectorX::Random(6);
+    m.shapeModes = q.transpose();
+    m.appearanceMean = aam::RowVectorX::Random(6);
+    m.appearanceModes = q.transpose();
+
+    aam::RowVectorX params(2);
+    params << aam::Scalar(0.5), aam::Scalar(-2);
+
+    // reconstruction into preallocated buffers
+    aam::RowVectorX shape(6), appearance(6);
+    m.reconstructShape(params, shape);
+    m.reconstructAppearance(params, appearance);
+    REQUIRE(shape.isApprox(m.shapeMean + params * m.shapeModes));
+    REQUIRE(appearance.isApprox(m.appearanceMean + params * m.appearanceModes));
+
+    // projection recovers the parameters
+    aam::RowVectorX shapeParams(2), appearanceParams(2);
+    m.projectShape(shape, shapeParams);
+    m.projectAppearance(appearance, appearanceParams);
+    REQUIRE(shapeParams.isApprox(params, aam::Scalar(1e-4)));
+    REQUIRE(appearanceParams.isApprox(params, aam::Scalar(1e-4)));
+
+    // buffers may be views into larger matrices
+    aam::MatrixX instances(2, 6);
+    m.reconstructAppearance(params, instances.row(1));
+    REQUIRE(instances.row(1).isApprox(appearance));
+}
\ No newline at end of file
@@ -28,15 +28,16 @@ along with AMM.  If not, see <http://www.gnu.org/licenses/>.
 TEST_CASE("pca-ray")
 {
     // Sample 2d points from line model
-    typedef Eigen::ParametrizedLine<float, 3> Ray;
+    typedef Eigen::ParametrizedLine<aam::Scalar, 3> Ray;
+    typedef Eigen::Matrix<aam::Scalar, Eigen::Dynamic, 1> VectorX;
     
-    Ray r(Eigen::Vector3f(2, 3, 0),
-          Eigen::Vector3f(1, 1, 1).normalized());
+    Ray r(Ray::VectorType(2, 3, 0),
+          Ray::VectorType(1, 1, 1).normalized());
 
-    Eigen::VectorXf ts = Eigen::VectorXf::Random(100);
+    VectorX ts = VectorX::Random(100);
     
     aam::MatrixX data(ts.size(), 3);
-    for (Eigen::VectorXf::Index i = 0; i < ts.rows(); ++i) {
+    for (VectorX::Index i = 0; i < ts.rows(); ++i) {
         data.row(i) = r.pointAt(ts(i));
     }
     
@@ -54,9 +55,9 @@ TEST_CASE("pca-ray")
     REQUIRE((basis.row(2) - r.direction().transpose()).norm() == Catch::Detail::Approx(0).epsilon(0.1));
 
     // Projection of data onto PCA basis is then a simple matter of matrix mul.
-    Eigen::MatrixXf proj = data * basis.bottomRows(dims).transpose();
-    const float corr = (r.origin().transpose() * basis.bottomRows(dims).transpose())(0);
-    for (Eigen::VectorXf::Index i = 0; i < ts.rows(); ++i) {
+    aam::MatrixX proj = data * basis.bottomRows(dims).transpose();
+    const aam::Scalar corr = (r.origin().transpose() * basis.bottomRows(dims).transpose())(0);
+    for (VectorX::Index i = 0; i < ts.rows(); ++i) {
         REQUIRE((proj(i, 0) - corr) == Catch::Detail::Approx(ts(i)).epsilon(0.1));
     }
 }
@@ -86,4 +87,26 @@ TEST_CASE("pca-gaussian")
     REQUIRE(pcamean.isApprox(mean, 0.1f));
     REQUIRE(std::abs(pcabasis.row(1).dot(aam::RowVector2(1, 1).normalized())) == Catch::Detail::Approx(1).epsilon(0.1));
     REQUIRE(std::abs(pcabasis.row(0).dot(aam::RowVector2(-1, 1).normalized())) == Catch::Detail::Approx(1).epsilon(0.1));
+}
+
+TEST_CASE("pca-double-precision")
+{
+    aam::RowVector2 mean;
+    mean << -1.f, 0.5f;
+    aam::MatrixX cov = generate2DCovarianceMatrixFromStretchAndRotation(3, 0.01, 0.0);
+    aam::MatrixX samples = sampleMultivariateGaussian(mean, cov, 50);
+
+    aam::RowVectorX pcamean;
+    aam::MatrixX pcabasis;
+    aam::RowVectorX pcaweights;
+    aam::computePCA(samples, pcamean, pcabasis, pcaweights);
+
+    aam::TrainingRowVectorX pcameand;
+    aam::TrainingMatrixX pcabasisd;
+    aam::TrainingRowVectorX pcaweightsd;
+    aam::computePCA<aam::TrainingScalar>(samples.cast<aam::TrainingScalar>(), pcameand, pcabasisd, pcaweightsd);
+
+    REQUIRE(pcameand.cast<aam::Scalar>().isApprox(pcamean, 1e-4f));
+    REQUIRE(pcaweightsd.cast<aam::Scalar>().isApprox(pcaweights, 1e-4f));
+    REQUIRE(std::abs(pcabasisd.row(1).cast<aam::Scalar>().dot(pcabasis.row(1))) == Catch::Detail::Approx(1).epsilon(1e-4));
 }
\ No newline at end of file
@@ -40,7 +40,7 @@ TEST_CASE("procrustes")
 
     // Note, Transform assumes column vectors, so we need to transpose it when applied to a matrix.
     Eigen::Transform<aam::Scalar, 2, Eigen::Affine> sim;
-    sim = Eigen::Rotation2D<aam::Scalar>(3.1415f) * Eigen::Scaling(5.f) * Eigen::Translation<aam::Scalar, 2>(-10.f, -10.f);
+    sim = Eigen::Rotation2D<aam::Scalar>(3.1415f) * Eigen::Scaling(aam::Scalar(5)) * Eigen::Translation<aam::Scalar, 2>(-10.f, -10.f);
 
     aam::MatrixX Y = (X.rowwise().homogeneous() * sim.matrix().transpose()).rowwise().hnormalized();
 
@@ -59,8 +59,8 @@ TEST_CASE("generalized-procustes")
 
     // Note, Transform assumes column vectors, so we need to transpose it when applied to a matrix.
     Eigen::Transform<aam::Scalar, 2, Eigen::Affine> sim1, sim2;
-    sim1 = Eigen::Rotation2D<aam::Scalar>(3.1415f) * Eigen::Scaling(5.f) * Eigen::Translation<aam::Scalar, 2>(-10.f, -10.f);
-    sim2 = Eigen::Scaling(2.f) * Eigen::Translation<aam::Scalar, 2>(5.f, 5.f);
+    sim1 = Eigen::Rotation2D<aam::Scalar>(3.1415f) * Eigen::Scaling(aam::Scalar(5)) * Eigen::Translation<aam::Scalar, 2>(-10.f, -10.f);
+    sim2 = Eigen::Scaling(aam::Scalar(2)) * Eigen::Translation<aam::Scalar, 2>(5.f, 5.f);
 
     aam::MatrixX Y = (X.rowwise().homogeneous() * sim1.matrix().transpose()).rowwise().hnormalized();
     aam::MatrixX Z = (X.rowwise().homogeneous() * sim2.matrix().transpose()).rowwise().hnormalized();
@@ -80,6 +80,12 @@ TEST_CASE("generalized-procustes")
     aam::MatrixX r = aam::generalizedProcrustes(C, 10);
     REQUIRE(r.row(0).isApprox(r.row(1)));
     REQUIRE(r.row(0).isApprox(r.row(2)));
+
+    // Same in training precision
+    aam::TrainingMatrixX rd = aam::generalizedProcrustes<aam::TrainingScalar>(C.cast<aam::TrainingScalar>(), 10);
+    REQUIRE(rd.row(0).isApprox(rd.row(1), 1e-4));
+    REQUIRE(rd.row(0).isApprox(rd.row(2), 1e-4));
+    REQUIRE(rd.cast<aam::Scalar>().isApprox(r, 1e-3f));
 }
 
 TEST_CASE("generalized-procrustes2") {
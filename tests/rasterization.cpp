@@ -46,6 +46,67 @@ TEST_CASE("rasterization")
     REQUIRE((r.leftCols(0).array() == aam::Scalar(0)).all());
 }
 
+TEST_CASE("rasterization-tiles")
+{
+    // Grid of triangles spanning multiple tiles with vertices off the pixel grid
+    const int n = 7;
+    const float step = 13.7f;
+
+    aam::MatrixX points(1, n * n * 2);
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            points(0, (y * n + x) * 2 + 0) = 0.3f + x * step + ((x + y) % 3) * 0.25f;
+            points(0, (y * n + x) * 2 + 1) = 0.6f + y * step + ((x * y) % 2) * 0.5f;
+        }
+    }
+
+    aam::RowVectorXi triangleIds((n - 1) * (n - 1) * 6);
+    int t = 0;
+    for (int y = 0; y < n - 1; ++y) {
+        for (int x = 0; x < n - 1; ++x) {
+            int i = y * n + x;
+            triangleIds(t++) = i; triangleIds(t++) = i + 1; triangleIds(t++) = i + n + 1;
+            triangleIds(t++) = i; triangleIds(t++) = i + n + 1; triangleIds(t++) = i + n;
+        }
+    }
+
+    // Reference scanning the shape bounds per triangle
+    aam::Scalar minX = points(0, 0), maxX = points(0, 0);
+    aam::Scalar minY = points(0, 1), maxY = points(0, 1);
+    for (int i = 0; i < n * n; ++i) {
+        minX = std::min(minX, points(0, i * 2)); maxX = std::max(maxX, points(0, i * 2));
+        minY = std::min(minY, points(0, i * 2 + 1)); maxY = std::max(maxY, points(0, i * 2 + 1));
+    }
+
+    std::vector<aam::RowVector3> coords;
+    for (int tri = 0; tri < triangleIds.size() / 3; ++tri) {
+        aam::ParametrizedTriangle pt(
+            points.row(0).segment(2 * triangleIds(tri * 3 + 0), 2),
+            points.row(0).segment(2 * triangleIds(tri * 3 + 1), 2),
+            points.row(0).segment(2 * triangleIds(tri * 3 + 2), 2));
+
+        for (int y = (int)minY; y < (int)(maxY + 1); ++y) {
+            for (int x = (int)minX; x < (int)(maxX + 1); ++x) {
+                aam::RowVector2 bary = pt.baryAt(aam::RowVector2(x + 0.5f, y + 0.5f));
+                if (pt.isBaryInside(bary)) {
+                    coords.push_back(aam::RowVector3(aam::Scalar(tri), bary(0), bary(1)));
+                }
+            }
+        }
+    }
+
+    aam::MatrixX r = aam::rasterizeShape(points, triangleIds, 100, 100);
+
+    REQUIRE(r.rows() == (aam::MatrixX::Index)coords.size());
+    REQUIRE(r.cols() == 3);
+
+    bool same = true;
+    for (size_t i = 0; i < coords.size(); ++i) {
+        same &= (r.row(i) == coords[i]);
+    }
+    REQUIRE(same);
+}
+
 TEST_CASE("write-image")
 {
     aam::MatrixX points(1, 3 * 2);
@@ -73,7 +134,7 @@ TEST_CASE("write-image")
         0, 0, 255, 0,
         0, 0, 0, 0;
         
-        REQUIRE(aam::toEigenHeader<float>(img).isApprox(shouldBe));
+        REQUIRE(aam::toEigenHeader<float>(img).isApprox(shouldBe.cast<float>()));
     }
     
     {
@@ -93,6 +154,88 @@ TEST_CASE("write-image")
                      0,   0,   0,   0,   0,   0, 255, 127,  63,   0,   0,   0,
                      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0;
         
-        REQUIRE(aam::toEigenHeader<float>(img).isApprox(shouldBe));
+        REQUIRE(aam::toEigenHeader<float>(img).isApprox(shouldBe.cast<float>()));
+    }
+}
+
+TEST_CASE("read-image")
+{
+    aam::MatrixX points(1, 3 * 2);
+    points << 1.f, 1.f, 7.f, 1.f, 7.f, 7.f;
+
+    aam::RowVectorXi triangleIds(3);
+    triangleIds << 0, 1, 2;
+
+    aam::MatrixX r = aam::rasterizeShape(points, triangleIds, 8, 8);
+
+    std::vector<aam::RowVector2> positions;
+    aam::barycentricToCartesian(points, triangleIds, r, positions);
+
+    // Linear ramp over pixel indices is reproduced exactly by bilinear interpolation
+    cv::Mat gray(8, 8, CV_32FC1);
+    cv::Mat color(8, 8, CV_8UC3);
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            gray.at<float>(y, x) = float(2 * x + 3 * y);
+            color.at<cv::Vec3b>(y, x) = cv::Vec3b(uchar(2 * x + 3 * y), uchar(x), uchar(y));
+        }
+    }
+
+    cv::Mat graySamples, colorSamples;
+    aam::readShapeImage(points, triangleIds, r, gray, graySamples);
+    aam::readShapeImage(points, triangleIds, r, color, colorSamples);
+
+    REQUIRE(graySamples.rows == (int)r.rows());
+    REQUIRE(graySamples.type() == CV_32FC1);
+    REQUIRE(colorSamples.type() == CV_8UC3);
+
+    for (size_t i = 0; i < positions.size(); ++i) {
+        aam::Scalar x = positions[i].x() - aam::Scalar(0.5);
+        aam::Scalar y = positions[i].y() - aam::Scalar(0.5);
+
+        REQUIRE(std::abs(graySamples.at<float>((int)i, 0) - (2 * x + 3 * y)) < 1e-4);
+
+        cv::Vec3b c = colorSamples.at<cv::Vec3b>((int)i, 0);
+        REQUIRE(std::abs(c[0] - (2 * x + 3 * y)) <= 0.5f);
+        REQUIRE(std::abs(c[1] - x) <= 0.5f);
+        REQUIRE(std::abs(c[2] - y) <= 0.5f);
+    }
+}
+
+TEST_CASE("shape-image-gradient")
+{
+    // Square composed of two triangles
+    aam::MatrixX points(1, 4 * 2);
+    points << 0.f, 0.f, 6.f, 0.f, 6.f, 6.f, 0.f, 6.f;
+
+    aam::RowVectorXi triangleIds(6);
+    triangleIds << 0, 1, 2, 0, 2, 3;
+
+    aam::MatrixX r = aam::rasterizeShape(points, triangleIds, 6, 6);
+
+    // Linear ramp
+    std::vector<aam::RowVector2> coords;
+    aam::barycentricToCartesian(points, triangleIds, r, coords);
+
+    aam::RowVectorX values(r.rows());
+    for (size_t i = 0; i < coords.size(); ++i) {
+        values(i) = 2.f * coords[i].x() + 3.f * coords[i].y();
+    }
+
+    aam::MatrixX g;
+    aam::computeShapeImageGradient(points, triangleIds, r, values, g);
+
+    REQUIRE(g.rows() == r.rows());
+    REQUIRE(g.cols() == 2);
+
+    for (size_t i = 0; i < coords.size(); ++i) {
+        const aam::RowVector2 &c = coords[i];
+        bool border = c.x() < 1.f || c.x() > 5.f || c.y() < 1.f || c.y() > 5.f;
+        if (border) {
+            REQUIRE(g.row(i).isZero());
+        } else {
+            REQUIRE(g(i, 0) == Approx(2.f));
+            REQUIRE(g(i, 1) == Approx(3.f));
+        }
     }
 }
\ No newline at end of file
@@ -20,7 +20,67 @@ along with AMM.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "catch.hpp"
 #include <aam/aam.h>
+#include <aam/io.h>
+#include <aam/trainingset.h>
+#include <aam/io/serialization.h>
+#include <opencv2/highgui/highgui.hpp>
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <iterator>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+    void makeDirectory(const std::string& path) {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    void writeFile(const std::string& path, const std::string& content) {
+        std::ofstream f(path.c_str(), std::ios::binary);
+        f << content;
+    }
+
+    /** Write a training set cache that passes verification but whose contents do not agree */
+    void writeInconsistentCache(const std::string& path, int variant) {
+        flatbuffers::FlatBufferBuilder fbb;
+
+        std::vector<double> shapeData(12, 0.5);
+        std::vector<int> triangleData(3, 0);
+        std::vector<uint8_t> pixels(10, 0);
+
+        // shapes announce more coordinates than stored
+        auto shapes = aam::io::CreateMatrixX(fbb, 2, variant == 0 ? 7 : 6, fbb.CreateVector(shapeData));
+        auto triangles = aam::io::CreateMatrixXi(fbb, 1, 3, fbb.CreateVector(triangleData));
+
+        // image announces more pixels than stored or has an invalid type
+        int rows = variant == 1 ? 100 : 2;
+        int type = variant == 2 ? (1 << 20) : CV_8UC1;
+        std::vector< flatbuffers::Offset<aam::io::Image> > images;
+        images.push_back(aam::io::CreateImage(fbb, rows, 5, type, fbb.CreateVector(pixels)));
+
+        // image of the second shape missing
+        if (variant != 4) {
+            images.push_back(aam::io::CreateImage(fbb, 2, 5, CV_8UC1, fbb.CreateVector(pixels)));
+        }
+        auto o4 = fbb.CreateVector(images);
+
+        // shapes missing
+        auto root = aam::io::CreateTrainingSet(fbb, variant == 3 ? flatbuffers::Offset<aam::io::MatrixX>() : shapes, triangles, 0, o4);
+        aam::io::FinishTrainingSetBuffer(fbb, root);
+
+        writeFile(path, std::string((const char*)fbb.GetBufferPointer(), fbb.GetSize()));
+    }
+}
 
 TEST_CASE("serialize")
 {
@@ -42,6 +102,7 @@ TEST_CASE("serialize")
     am.shapeModeWeights = m.row(4);
     am.triangleIndices = tris;
     am.shapeTransformToTrainingData = a;
+    am.appearanceMeanGradient = m.leftCols(2);
 
     am.save("aam.bin");
 
@@ -58,4 +119,196 @@ TEST_CASE("serialize")
     REQUIRE(am.shapeModeWeights.isApprox(m.row(4)));
     REQUIRE(am.triangleIndices.isApprox(tris));
     REQUIRE(am.shapeTransformToTrainingData.isApprox(a));
+    REQUIRE(am.appearanceMeanGradient.isApprox(m.leftCols(2)));
+}
+
+TEST_CASE("serialize-trainingset")
+{
+    aam::TrainingSet ts;
+    ts.shapes = aam::MatrixX::Random(2, 6);
+    ts.triangles.resize(3);
+    ts.triangles << 0, 1, 2;
+    ts.contour = cv::Mat(3, 3, CV_32SC1, cv::Scalar(7));
+
+    cv::Mat gray(5, 7, CV_8UC1);
+    cv::Mat color(4, 3, CV_8UC3);
+    for (int r = 0; r < gray.rows; ++r)
+        for (int c = 0; c < gray.cols; ++c)
+            gray.at<uchar>(r, c) = (uchar)(r * gray.cols + c);
+    for (int r = 0; r < color.rows; ++r)
+        for (int c = 0; c < color.cols; ++c)
+            color.at<cv::Vec3b>(r, c) = cv::Vec3b((uchar)r, (uchar)c, (uchar)(r + c));
+    ts.images.push_back(gray);
+    ts.images.push_back(color);
+
+    REQUIRE(aam::saveTrainingSetCache("trainingset.bin", ts));
+
+    aam::TrainingSet loaded;
+    REQUIRE(aam::loadTrainingSetCache("trainingset.bin", loaded));
+
+    REQUIRE(loaded.shapes.isApprox(ts.shapes));
+    REQUIRE(loaded.triangles == ts.triangles);
+    REQUIRE(loaded.contour.type() == CV_32SC1);
+    REQUIRE(loaded.contour.at<int>(2, 2) == 7);
+    REQUIRE(loaded.images.size() == 2);
+    REQUIRE(loaded.images[0].type() == CV_8UC1);
+    REQUIRE(loaded.images[1].type() == CV_8UC3);
+    REQUIRE(loaded.images[0].rows == 5);
+    REQUIRE(loaded.images[0].cols == 7);
+
+    bool same = true;
+    for (int r = 0; r < gray.rows; ++r)
+        for (int c = 0; c < gray.cols; ++c)
+            same &= loaded.images[0].at<uchar>(r, c) == gray.at<uchar>(r, c);
+    for (int r = 0; r < color.rows; ++r)
+        for (int c = 0; c < color.cols; ++c)
+            same &= loaded.images[1].at<cv::Vec3b>(r, c) == color.at<cv::Vec3b>(r, c);
+    REQUIRE(same);
+
+    // Not a training set cache
+    REQUIRE(!aam::loadTrainingSetCache("aam.bin", loaded));
+}
+
+TEST_CASE("load-inconsistent-trainingset-cache")
+{
+    aam::TrainingSet ts;
+    ts.shapes = aam::MatrixX::Random(1, 6);
+    ts.triangles.resize(3);
+    ts.triangles << 0, 1, 2;
+    ts.images.push_back(cv::Mat(5, 7, CV_8UC1, cv::Scalar(3)));
+    REQUIRE(aam::saveTrainingSetCache("trainingset.bin", ts));
+
+    // The layout of the consistent cache is accepted.
+    writeInconsistentCache("inconsistent.bin", -1);
+    aam::TrainingSet loaded;
+    REQUIRE(aam::loadTrainingSetCache("inconsistent.bin", loaded));
+    REQUIRE(loaded.images[0].rows == 2);
+
+    for (int variant = 0; variant < 5; ++variant) {
+        writeInconsistentCache("inconsistent.bin", variant);
+        REQUIRE(aam::loadTrainingSetCache("trainingset.bin", loaded));
+        REQUIRE(!aam::loadTrainingSetCache("inconsistent.bin", loaded));
+        
+        // left unchanged
+        REQUIRE(loaded.images.size() == 1);
+        REQUIRE(loaded.images[0].cols == 7);
+    }
+
+    // Truncated cache fails verification
+    std::ifstream f("trainingset.bin", std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    writeFile("truncated.bin", content.substr(0, content.size() / 2));
+    REQUIRE(!aam::loadTrainingSetCache("truncated.bin", loaded));
+}
+
+TEST_CASE("parse-asf")
+{
+    std::string asf =
+        "######################\n"
+        "# AAM shape file\n"
+        "######################\n"
+        "\n"
+        "3\r\n"
+        "# <path#> <type> <x rel.> <y rel.> <point#> <connects from> <connects to>\n"
+        "0 0 0.25 0.5 0 2 1\n"
+        "0\t0 \t1.5e-1 -0.75 1 0 2\r\n"
+        "0 0 .5 1 2 1 0\n"
+        "\n"
+        "01-1m.jpg";
+
+    aam::RowVectorX coords;
+    cv::Mat contour;
+    REQUIRE(aam::parseAsf(asf.data(), asf.data() + asf.size(), coords, contour) == aam::ASF_OK);
+    
+    REQUIRE(coords.cols() == 6);
+    REQUIRE(coords(0) == Approx(0.25));
+    REQUIRE(coords(1) == Approx(0.5));
+    REQUIRE(coords(2) == Approx(0.15));
+    REQUIRE(coords(3) == Approx(-0.75));
+    REQUIRE(coords(4) == Approx(0.5));
+    REQUIRE(coords(5) == Approx(1));
+
+    REQUIRE(contour.rows == 3);
+    REQUIRE(contour.at<int>(1, 0) == 1);
+    REQUIRE(contour.at<int>(1, 1) == 0);
+    REQUIRE(contour.at<int>(1, 2) == 2);
+
+    // Input is not required to be null terminated
+    std::string truncated = "1\n0 0 0.25 0.5 0 0 79";
+    REQUIRE(aam::parseAsf(truncated.data(), truncated.data() + truncated.size() - 1, coords, contour) == aam::ASF_OK);
+    REQUIRE(coords(0) == Approx(0.25));
+    REQUIRE(contour.at<int>(0, 2) == 7);
+
+    std::string noCount = "# comment only\n";
+    REQUIRE(aam::parseAsf(noCount.data(), noCount.data() + noCount.size(), coords, contour) == aam::ASF_INVALID_POINT_COUNT);
+
+    std::string badCount = "3x\n";
+    REQUIRE(aam::parseAsf(badCount.data(), badCount.data() + badCount.size(), coords, contour) == aam::ASF_INVALID_POINT_COUNT);
+
+    std::string badPoint = "2\n0 0 0.25 0.5 0 1 1\n0 0 0.25 abc 1 0 0\n";
+    REQUIRE(aam::parseAsf(badPoint.data(), badPoint.data() + badPoint.size(), coords, contour) == aam::ASF_INVALID_POINT);
+
+    std::string shortPoint = "1\n0 0 0.25 0.5 0\n";
+    REQUIRE(aam::parseAsf(shortPoint.data(), shortPoint.data() + shortPoint.size(), coords, contour) == aam::ASF_INVALID_POINT);
+
+    std::string missing = "2\n0 0 0.25 0.5 0 1 1\n";
+    REQUIRE(aam::parseAsf(missing.data(), missing.data() + missing.size(), coords, contour) == aam::ASF_MISSING_POINTS);
+
+    std::vector<char> buffer;
+    REQUIRE(aam::parseAsfFile("does-not-exist.asf", coords, contour, buffer) == aam::ASF_FILE_ERROR);
+}
+
+TEST_CASE("load-asf-image-errors")
+{
+    const std::string dir = "asf-image-errors";
+    makeDirectory(dir);
+
+    const std::string asf = "3\n0 0 0.25 0.25 0 2 1\n0 0 0.75 0.25 1 0 2\n0 0 0.5 0.75 2 1 0\n";
+    writeFile(dir + "/01-1m.asf", asf);
+    writeFile(dir + "/02-1m.asf", asf);
+    writeFile(dir + "/03-1m.asf", asf);
+
+    cv::Mat img(20, 30, CV_8UC1, cv::Scalar(128));
+    REQUIRE(cv::imwrite(dir + "/01-1m.jpg", img));
+    
+    // Image of the second example is missing, also when left over from a previous run
+    std::remove((dir + "/02-1m.jpg").c_str());
+    {
+        aam::AsfTrainingSetLoader loader(dir, -1, false, 2, 2);
+        aam::TrainingSet ts;
+        REQUIRE(loader.open(ts));
+        
+        cv::Mat image;
+        REQUIRE(loader.next(image));
+        REQUIRE(image.cols == 30);
+        REQUIRE(!loader.failed());
+        
+        REQUIRE(!loader.next(image));
+        REQUIRE(loader.failed());
+        REQUIRE(loader.failedExample() == 1);
+        REQUIRE(!loader.next(image));
+
+        aam::TrainingSet all;
+        REQUIRE(!aam::loadAsfTrainingSet(dir, all));
+    }
+
+    // Image of the third example is corrupt
+    REQUIRE(cv::imwrite(dir + "/02-1m.jpg", img));
+    writeFile(dir + "/03-1m.jpg", "not an image");
+    {
+        aam::AsfTrainingSetLoader loader(dir);
+        aam::TrainingSet ts;
+        REQUIRE(loader.open(ts));
+
+        cv::Mat image;
+        REQUIRE(loader.next(image));
+        REQUIRE(loader.next(image));
+        REQUIRE(!loader.next(image));
+        REQUIRE(loader.failedExample() == 2);
+
+        aam::TrainingSet all;
+        REQUIRE(!aam::loadAsfTrainingSet(dir, all));
+        REQUIRE(aam::loadAsfTrainingSet(dir, all, 2));
+        REQUIRE(all.images.size() == 2);
+    }
 }
\ No newline at end of file
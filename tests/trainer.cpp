@@ -0,0 +1,92 @@
+/**
+This file is part of Active Appearance Models (AMM).
+
+Copyright Christoph Heindl 2015
+Copyright Sebastian Zambal 2015
+
+AMM is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+AMM is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with AMM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "catch.hpp"
+#include <aam/trainer.h>
+#include <aam/trainingset.h>
+#include <aam/model.h>
+#include <aam/transform.h>
+#include <aam/views.h>
+
+namespace {
+
+    /** Square of four points split into two triangles, varying slightly in size */
+    void createTrainingSet(aam::TrainingSet& ts) {
+        const aam::Scalar sizes[] = { 30, 32, 35 };
+        ts.shapes.resize(3, 8);
+        for (int i = 0; i < 3; ++i) {
+            aam::Scalar s = sizes[i];
+            ts.shapes.row(i) << 10, 10, 10 + s, 10, 10 + s, 10 + s + i, 10, 10 + s;
+
+            cv::Mat img(60, 60, CV_8UC1);
+            for (int y = 0; y < img.rows; ++y) {
+                for (int x = 0; x < img.cols; ++x) {
+                    img.at<unsigned char>(y, x) = (unsigned char)((x * 3 + y * 2 + i * 5) % 256);
+                }
+            }
+            ts.images.push_back(img);
+        }
+
+        ts.triangles.resize(6);
+        ts.triangles << 0, 1, 2, 0, 2, 3;
+    }
+
+    aam::RowVector2 extentInTrainingData(const aam::ActiveAppearanceModel& m) {
+        aam::RowVectorX s0 = aam::transformShape(m.shapeTransformToTrainingData, m.shapeMean);
+        auto points = aam::toSeparatedViewConst<aam::Scalar>(s0);
+        return points.colwise().maxCoeff() - points.colwise().minCoeff();
+    }
+}
+
+TEST_CASE("trainer-appearance-resolution")
+{
+    aam::TrainingSet ts;
+    createTrainingSet(ts);
+
+    aam::ActiveAppearanceModel full;
+    REQUIRE(aam::Trainer(ts).train(full));
+
+    aam::ActiveAppearanceModel small;
+    aam::Trainer t(ts);
+    t.setAppearanceResolution(16);
+    t.train(small);
+
+    // mean shape spans the requested number of pixels, samples shrink accordingly
+    REQUIRE(extentInTrainingData(small).maxCoeff() == Approx(16));
+    REQUIRE(small.barycentricSamplePositions.rows() < full.barycentricSamplePositions.rows() / 3);
+    REQUIRE(small.appearanceMean.cols() == small.barycentricSamplePositions.rows());
+    REQUIRE(small.appearanceMeanGradient.rows() == small.barycentricSamplePositions.rows());
+
+    // shape statistics in normalized coordinates do not depend on the resolution
+    REQUIRE(small.shapeMean.isApprox(full.shapeMean, aam::Scalar(1e-4)));
+    REQUIRE(small.shapeModeWeights.isApprox(full.shapeModeWeights, aam::Scalar(1e-3)));
+
+    aam::ActiveAppearanceModel sampled;
+    aam::Trainer t2(ts);
+    t2.setAppearanceSamples(400);
+    t2.train(sampled);
+
+    REQUIRE(std::abs((int)sampled.barycentricSamplePositions.rows() - 400) < 60);
+
+    // missing images are reported
+    ts.images.pop_back();
+    aam::ActiveAppearanceModel incomplete;
+    REQUIRE(!aam::Trainer(ts).train(incomplete));
+}
\ No newline at end of file